@@ -0,0 +1,95 @@
+#!/bin/bash
+# 描画バックエンド（egl: EGL/GLES、shm: wl_shm）を、同じシーン・サイズ・フレーム数でweston（headlessバックエンド）上で実行し、
+# 各クライアントが出力する「[result] ...」の行をCSVとJSONにまとめる（cmake --build <dir> --target bench から実行される）
+# ・シーン：ひし形（diamond）を、ダメージトラッキングあり（tracked）と毎フレーム全体描画（full）の2通り
+# ・サイズ：SIZES（既定: 320x320 1280x720 1920x1080）
+# ・バックエンド：BACKENDS（既定: egl shm）。westonにGLレンダラがない場合、eglは計測できないため除く
+# ・PROTOCOL_STATS=1の場合は、Waylandの通信量（--protocol-stats）も計測して列に加える
+#   （計測のフックの分だけfps以外の項目にも影響するため、既定では計測しない）
+# 項目の意味はsrc/run_summary.hを参照
+#
+# 使い方: bash bench/backend_suite.sh [ビルドディレクトリ(既定: build)] [出力ディレクトリ(既定: <ビルドディレクトリ>/bench)] [フレーム数(既定: 300)]
+
+set -eu
+
+BUILD_DIR=${1:-build}
+OUT_DIR=${2:-$BUILD_DIR/bench}
+FRAMES=${3:-300}
+SIZES=${SIZES:-"320x320 1280x720 1920x1080"}
+BACKENDS=${BACKENDS:-"egl shm"}
+SOCKET=wayland-backend-suite-$$
+
+export XDG_RUNTIME_DIR=${XDG_RUNTIME_DIR:-/run/user/$(id -u)}
+mkdir -p "$XDG_RUNTIME_DIR" "$OUT_DIR"
+chmod 0700 "$XDG_RUNTIME_DIR"
+
+if ! command -v weston > /dev/null; then
+    echo "[backend-suite] skipped: weston is not installed"
+    exit 0
+fi
+# EGLクライアントにはGLレンダラ（weston 9以降の--use-gl）が必要
+if weston --help 2>&1 | grep -q -- "--use-gl"; then
+    RENDERER=--use-gl
+else
+    RENDERER=--use-pixman
+    BACKENDS=$(echo "$BACKENDS" | tr ' ' '\n' | grep -vx egl | tr '\n' ' ' || true)
+    echo "[backend-suite] egl skipped: this weston's headless backend has no GL renderer"
+fi
+weston --backend=headless-backend.so "$RENDERER" --socket="$SOCKET" --idle-time=0 &
+WESTON_PID=$!
+trap 'kill $WESTON_PID 2>/dev/null || true' EXIT
+
+for _ in $(seq 50); do
+    [ -S "$XDG_RUNTIME_DIR/$SOCKET" ] && break
+    sleep 0.1
+done
+export WAYLAND_DISPLAY=$SOCKET
+
+# バックエンド名から実行するクライアントを選ぶ
+client() {
+    case $1 in
+        egl) echo "$BUILD_DIR/my_wayland_client --backend egl" ;;
+        shm) echo "$BUILD_DIR/my_wayland_client --backend shm" ;;
+        *) echo "unknown backend: $1" >&2; exit 1 ;;
+    esac
+}
+
+COLUMNS="backend scene damage size frames fps frame_ms_p50 frame_ms_p99 frame_cost_ms cpu_ms_per_frame rss_kb pss_kb"
+STATS_FLAGS=
+if [ "${PROTOCOL_STATS:-0}" = 1 ]; then
+    COLUMNS="$COLUMNS requests_per_frame events_per_frame wire_bytes_per_frame"
+    STATS_FLAGS=--protocol-stats
+fi
+CSV=$OUT_DIR/backend_suite.csv
+JSON=$OUT_DIR/backend_suite.json
+echo "$COLUMNS" | tr ' ' ',' > "$CSV"
+
+for BACKEND in $BACKENDS; do
+    for SIZE in $SIZES; do
+        for DAMAGE in tracked full; do
+            FLAGS="--frames $FRAMES --size $SIZE $STATS_FLAGS"
+            [ "$DAMAGE" = full ] && FLAGS="$FLAGS --full-damage"
+            RESULT=$($(client "$BACKEND") $FLAGS | grep '^\[result\]')
+            echo "$RESULT"
+            # 「key=value」の並びから、COLUMNSの順に値を取り出す
+            echo "$RESULT" | awk -v columns="$COLUMNS" '{
+                for (i = 2; i <= NF; ++i) { split($i, kv, "="); value[kv[1]] = kv[2] }
+                n = split(columns, keys, " ")
+                for (i = 1; i <= n; ++i) printf "%s%s", value[keys[i]], (i < n ? "," : "\n")
+            }' >> "$CSV"
+        done
+    done
+done
+
+# CSVと同じ内容を、数値はそのまま・文字列は引用符で囲んだJSONの配列にする
+awk -F, 'NR == 1 { n = split($0, keys, ","); print "["; next }
+{
+    printf "%s  {", (NR > 2 ? ",\n" : "")
+    for (i = 1; i <= n; ++i) {
+        quoted = ($i ~ /^-?[0-9.]+$/) ? $i : "\"" $i "\""
+        printf "\"%s\": %s%s", keys[i], quoted, (i < n ? ", " : "}")
+    }
+}
+END { print "\n]" }' "$CSV" > "$JSON"
+
+echo "[backend-suite] wrote $CSV and $JSON"
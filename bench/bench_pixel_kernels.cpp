@@ -0,0 +1,130 @@
+// ピクセル書き込みカーネル（pixel_kernels.h）の実装ごとのスループット計測
+// 各サイズ・各カーネルについて、スカラー実装と出力がビット単位で一致することも確認する
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "pixel_kernels.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Size
+{
+    const char *name;
+    int width, height;
+};
+
+// 1回分のカーネル呼び出し。phaseはフレームごとに変えて、毎回異なる内容を書き込む
+enum class Kernel
+{
+    Fill,
+    FillRect,
+    Pattern,
+    Rgb565
+};
+
+static const char *kernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Fill:
+        return "fill";
+    case Kernel::FillRect:
+        return "fill_rect";
+    case Kernel::Rgb565:
+        return "rgb565";
+    default:
+        return "pattern";
+    }
+}
+
+// fill_rectは画像中央の半分の領域（端数のある幅でも正しく動くよう、幅は奇数に寄せる）
+static void rectOf(const Size &size, int &x, int &y, int &w, int &h)
+{
+    x = size.width / 4 + 1;
+    y = size.height / 4;
+    w = (size.width / 2) | 1;
+    h = size.height / 2;
+}
+
+// rgb565はsource（XRGB8888）を変換してbufferの先頭に書き込む。バイト数は読み込みと書き込みの合計
+static size_t run(const PixelKernels &kernels, Kernel kernel, const Size &size, uint32_t *buffer, const uint32_t *source,
+                  uint32_t phase)
+{
+    const int pitch = size.width;
+    int x, y, w, h;
+    switch (kernel)
+    {
+    case Kernel::Fill:
+        kernels.fill(buffer, static_cast<size_t>(size.width) * size.height, 0xff000000u | phase);
+        return static_cast<size_t>(size.width) * size.height * 4;
+    case Kernel::FillRect:
+        rectOf(size, x, y, w, h);
+        kernels.fillRect(buffer, pitch, x, y, w, h, 0xff000000u | phase);
+        return static_cast<size_t>(w) * h * 4;
+    case Kernel::Rgb565:
+        kernels.toRgb565(reinterpret_cast<uint16_t *>(buffer), source, static_cast<size_t>(size.width) * size.height);
+        return static_cast<size_t>(size.width) * size.height * 6;
+    default:
+        kernels.pattern(buffer, pitch, 0, 0, size.width, size.height, phase);
+        return static_cast<size_t>(size.width) * size.height * 4;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+    const std::vector<Size> sizes = {{"320x320", 320, 320}, {"1920x1080", 1920, 1080}, {"3840x2160", 3840, 2160}};
+    const auto variants = pixel_kernels::available();
+    bool identical = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto &size : sizes)
+    {
+        const size_t pixels = static_cast<size_t>(size.width) * size.height;
+        std::vector<uint32_t> buffer(pixels), reference(pixels), source(pixels);
+        // 変換元は全チャンネルの値が散らばるよう、座標から適当に作る
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            source[i] = 0xff000000u | static_cast<uint32_t>(i * 2654435761u >> 8);
+        }
+
+        for (Kernel kernel : {Kernel::Fill, Kernel::FillRect, Kernel::Pattern, Kernel::Rgb565})
+        {
+            // スカラー実装の出力を基準にする
+            std::fill(reference.begin(), reference.end(), 0u);
+            run(pixel_kernels::scalar(), kernel, size, reference.data(), source.data(), 7);
+
+            for (const PixelKernels *kernels : variants)
+            {
+                std::fill(buffer.begin(), buffer.end(), 0u);
+                run(*kernels, kernel, size, buffer.data(), source.data(), 7);
+                const bool match = std::memcmp(buffer.data(), reference.data(), pixels * 4) == 0;
+                identical = identical && match;
+
+                size_t bytes = 0;
+                const auto start = Clock::now();
+                for (int i = 0; i < iterations; ++i)
+                {
+                    bytes += run(*kernels, kernel, size, buffer.data(), source.data(), static_cast<uint32_t>(i));
+                }
+                const double sec = std::chrono::duration<double>(Clock::now() - start).count();
+
+                std::cout << size.name << " " << std::setw(9) << kernelName(kernel) << " " << std::setw(6) << kernels->name
+                          << " " << std::setw(8) << bytes / sec / 1e9 << " GB/s"
+                          << " " << std::setw(8) << sec * 1e3 / iterations << " ms/frame"
+                          << (match ? "" : "  MISMATCH") << std::endl;
+            }
+        }
+    }
+
+    if (!identical)
+    {
+        std::cerr << "出力がスカラー実装と一致しないカーネルがあります" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
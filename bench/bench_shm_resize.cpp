@@ -0,0 +1,156 @@
+// ウィンドウの端をドラッグした時のような、少しずつのサイズ変更を続けた場合のwl_shmバッファの確保の比較
+// ・recreate：サイズが変わるたびにアリーナ（memfd）ごと作り直す（wl_shellの頃のprimitive.cppでサイズを変える場合の方式）
+// ・exact   ：同じアリーナから、新しいサイズぴったりの領域を確保し直す
+// ・reuse   ：確保済みの領域に収まれば使い回し、収まらない場合はShmArena::grownCapacityで大きめに確保し直す（ShmBufferPool::resize）
+// 1回のサイズ変更あたりの時間は、全バッファの確保し直しと、新しいサイズでの最初の1フレーム分の書き込み（ページフォルトを含む）
+// Waylandのリクエスト（wl_buffer/wl_shm_poolの作成）はコンポジタ側のコストになるため、ここではクライアント側のみを計測する
+//
+// 使い方: bench_shm_resize [ドラッグの往復回数(既定: 3)]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "shm_arena.h"
+
+using Clock = std::chrono::steady_clock;
+
+// ShmBufferPoolの既定のバッファ数
+static constexpr int bufferCount = 2;
+
+enum class Strategy
+{
+    Recreate,
+    Exact,
+    Reuse
+};
+
+struct Size
+{
+    int width, height;
+};
+
+// 320x320から1920x1080まで8ピクセルずつ広げ、また戻す（往復をroundTrips回）
+static std::vector<Size> dragSequence(int roundTrips)
+{
+    std::vector<Size> forward;
+    for (int width = 320, height = 320; width < 1920 || height < 1080;)
+    {
+        width = std::min(width + 8, 1920);
+        height = std::min(height + 8, 1080);
+        forward.push_back({width, height});
+    }
+    std::vector<Size> sizes;
+    for (int i = 0; i < roundTrips; ++i)
+    {
+        sizes.insert(sizes.end(), forward.begin(), forward.end());
+        sizes.insert(sizes.end(), forward.rbegin() + 1, forward.rend());
+        sizes.push_back({320, 320});
+    }
+    return sizes;
+}
+
+struct Result
+{
+    std::vector<double> resizeUs;
+    uint64_t allocations = 0;
+    uint64_t arenaGrows = 0;
+    size_t capacity = 0;
+};
+
+static Result run(Strategy strategy, const std::vector<Size> &sizes)
+{
+    const size_t initialSize = static_cast<size_t>(320) * 4 * 320;
+    std::unique_ptr<ShmArena> arena(new ShmArena(initialSize * bufferCount));
+    struct Buffer
+    {
+        size_t offset, capacity;
+    };
+    std::vector<Buffer> buffers;
+    for (int i = 0; i < bufferCount; ++i)
+    {
+        buffers.push_back({arena->allocate(initialSize), initialSize});
+    }
+
+    Result result;
+    result.resizeUs.reserve(sizes.size());
+    for (const Size &s : sizes)
+    {
+        const size_t size = static_cast<size_t>(s.width) * 4 * s.height;
+        const auto start = Clock::now();
+        if (strategy == Strategy::Recreate)
+        {
+            result.arenaGrows += arena->getGrowCount();
+            arena.reset(new ShmArena(size * bufferCount));
+            for (Buffer &buffer : buffers)
+            {
+                buffer = {arena->allocate(size), size};
+                ++result.allocations;
+            }
+        }
+        else
+        {
+            for (Buffer &buffer : buffers)
+            {
+                const size_t capacity = strategy == Strategy::Exact ? size : ShmArena::grownCapacity(buffer.capacity, size);
+                if (strategy == Strategy::Reuse && capacity == buffer.capacity)
+                {
+                    continue;
+                }
+                arena->release(buffer.offset);
+                buffer = {arena->allocate(capacity), capacity};
+                ++result.allocations;
+            }
+        }
+        // 新しいサイズの最初のフレームを描画する
+        std::memset(arena->at(buffers.front().offset), 0xff, size);
+        result.resizeUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    result.arenaGrows += arena->getGrowCount();
+    result.capacity = arena->getCapacity();
+    return result;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+int main(int argc, char **argv)
+{
+    const int roundTrips = argc > 1 ? std::atoi(argv[1]) : 3;
+    const std::vector<Size> sizes = dragSequence(roundTrips);
+
+    struct Case
+    {
+        const char *name;
+        Strategy strategy;
+    };
+    const Case cases[] = {{"recreate", Strategy::Recreate}, {"exact", Strategy::Exact}, {"reuse", Strategy::Reuse}};
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const Case &c : cases)
+    {
+        const Result result = run(c.strategy, sizes);
+        double total = 0.0;
+        for (double us : result.resizeUs)
+        {
+            total += us;
+        }
+        std::cout << std::setw(8) << c.name
+                  << " resizes=" << sizes.size()
+                  << " allocations=" << result.allocations
+                  << " arena_grows=" << result.arenaGrows
+                  << " arena_kb=" << result.capacity / 1024
+                  << " resize_us(avg=" << total / sizes.size()
+                  << " p50=" << percentile(result.resizeUs, 0.50)
+                  << " p99=" << percentile(result.resizeUs, 0.99)
+                  << " max=" << percentile(result.resizeUs, 1.0) << ")" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
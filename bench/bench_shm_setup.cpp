@@ -0,0 +1,98 @@
+// wl_shmバッファのセットアップにかかる時間の比較
+// ・legacy : 従来のprimitive.cppの方式（/tmpにmkstemp → unlink → ftruncate → mmap → 書き込み → munmap → close）
+// ・arena  : ShmArena（memfd）からのサブ領域の切り出しと返却
+// Waylandのリクエスト（wl_shm_create_pool等）はコンポジタ側のコストになるため、ここではクライアント側のシステムコールのみを計測する
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "shm_arena.h"
+
+using Clock = std::chrono::steady_clock;
+
+// 従来のcreate_anonymous_file + mmapによるバッファ1枚分のセットアップと破棄
+static void legacySetup(size_t size)
+{
+    char path[] = "/tmp/wayland-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to create temporary file");
+    }
+    unlink(path);
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to resize temporary file");
+    }
+    auto *data = static_cast<uint8_t *>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to map memory");
+    }
+    // 描画時と同様にページフォルトを発生させる
+    std::memset(data, 0xff, size);
+    munmap(data, size);
+    close(fd);
+}
+
+// アリーナからバッファ1枚分を切り出して書き込み、返却する
+static void arenaSetup(ShmArena &arena, size_t size)
+{
+    const size_t offset = arena.allocate(size);
+    std::memset(arena.at(offset), 0xff, size);
+    arena.release(offset);
+}
+
+template <typename F>
+static double measureUs(int iterations, F &&fn)
+{
+    const auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        fn();
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    struct Size
+    {
+        const char *name;
+        int width, height;
+    };
+    const std::vector<Size> sizes = {{"320x320", 320, 320}, {"1920x1080", 1920, 1080}, {"3840x2160", 3840, 2160}};
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto &s : sizes)
+    {
+        const size_t size = static_cast<size_t>(s.width) * 4 * s.height;
+
+        const double legacyUs = measureUs(iterations, [&] { legacySetup(size); });
+
+        // アリーナの作成（初回のみのコスト）と、定常状態での切り出しを分けて計測する
+        const auto createStart = Clock::now();
+        ShmArena arena(size * 2);
+        const double createUs = std::chrono::duration<double, std::micro>(Clock::now() - createStart).count();
+        const double arenaUs = measureUs(iterations, [&] { arenaSetup(arena, size); });
+
+        std::cout << s.name
+                  << " legacy=" << legacyUs << "us"
+                  << " arena_create=" << createUs << "us"
+                  << " arena=" << arenaUs << "us"
+                  << " speedup=" << legacyUs / arenaUs << "x" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
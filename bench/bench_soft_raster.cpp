@@ -0,0 +1,126 @@
+// ソフトウェアラスタライザ（soft_rasterizer.h）の計測
+// ・diamond : --backend eglと同じひし形（GL_TRIANGLE_FAN、4頂点）を背景塗りつぶし込みで描画
+// ・soup    : 乱数で生成した小さな三角形を多数描画（三角形セットアップとブロック判定の負荷）
+// 各カーネル実装の出力がスカラー実装とビット単位で一致することも確認する
+// GL側との比較は、同じシーンを描画する my_wayland_client --backend egl --uncapped --frames N の結果を参照する
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "scene.h"
+#include "soft_rasterizer.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Size
+{
+    const char *name;
+    int width, height;
+};
+
+static void drawDiamond(const SoftRasterizer &rasterizer, const PixelKernels &kernels, uint32_t *buffer,
+                        const Size &size, const Tile &tile, float timeSec)
+{
+    float vertices[scene::diamondVertexCount * 3];
+    scene::diamondVertices(scene::diamondCenterX(timeSec), vertices);
+    kernels.fillRect(buffer, size.width, tile.x, tile.y, tile.w, tile.h, scene::backgroundColor);
+    rasterizer.drawTriangleFan(vertices, scene::diamondVertexCount, scene::diamondColor, tile);
+}
+
+static void drawSoup(const SoftRasterizer &rasterizer, const PixelKernels &kernels, uint32_t *buffer,
+                     const Size &size, const Tile &tile, const std::vector<float> &soup)
+{
+    kernels.fillRect(buffer, size.width, tile.x, tile.y, tile.w, tile.h, scene::backgroundColor);
+    rasterizer.drawTriangles(soup.data(), static_cast<int>(soup.size() / 3), scene::diamondColor, tile);
+}
+
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+    const unsigned threads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 1;
+    const std::vector<Size> sizes = {{"320x320", 320, 320}, {"1920x1080", 1920, 1080}, {"3840x2160", 3840, 2160}};
+
+    // 0.05程度の大きさの三角形を1000個
+    std::vector<float> soup;
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f), offset(-0.05f, 0.05f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const float cx = position(random), cy = position(random);
+        for (int v = 0; v < 3; ++v)
+        {
+            soup.push_back(cx + offset(random));
+            soup.push_back(cy + offset(random));
+            soup.push_back(0.0f);
+        }
+    }
+
+    ThreadPool pool(threads);
+    TileRenderer tileRenderer(pool);
+    bool identical = true;
+
+    std::cout << "threads=" << pool.size() << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto &size : sizes)
+    {
+        std::vector<uint32_t> buffer(static_cast<size_t>(size.width) * size.height);
+        std::vector<uint32_t> reference(buffer.size());
+
+        for (const char *sceneName : {"diamond", "soup"})
+        {
+            const bool diamond = std::strcmp(sceneName, "diamond") == 0;
+            for (const PixelKernels *kernels : pixel_kernels::available())
+            {
+                SoftRasterizer rasterizer;
+                rasterizer.setKernels(*kernels);
+                rasterizer.setTarget(buffer.data(), size.width, size.width, size.height);
+
+                auto renderFrame = [&](float timeSec) {
+                    tileRenderer.render(size.width, size.height, [&](const Tile &tile) {
+                        if (diamond)
+                        {
+                            drawDiamond(rasterizer, *kernels, buffer.data(), size, tile, timeSec);
+                        }
+                        else
+                        {
+                            drawSoup(rasterizer, *kernels, buffer.data(), size, tile, soup);
+                        }
+                    });
+                };
+
+                // 中心が画素境界からずれる時刻で描画した結果を比較する
+                renderFrame(0.37f);
+                if (kernels == pixel_kernels::available().front())
+                {
+                    reference = buffer;
+                }
+                const bool match = buffer == reference;
+                identical = identical && match;
+
+                const auto start = Clock::now();
+                for (int i = 0; i < iterations; ++i)
+                {
+                    renderFrame(i / 60.0f);
+                }
+                const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+
+                std::cout << size.name << " " << std::setw(7) << sceneName << " " << std::setw(6) << kernels->name
+                          << " " << std::setw(8) << ms << " ms/frame"
+                          << " " << std::setw(8) << 1000.0 / ms << " fps"
+                          << (match ? "" : "  MISMATCH") << std::endl;
+            }
+        }
+    }
+
+    if (!identical)
+    {
+        std::cerr << "出力がスカラー実装と一致しないカーネルがあります" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+// タイル分割による並列描画（tile_renderer.h）のスケーリング計測
+// スレッド数と画面サイズを変えながら、XORパターンの描画にかかる時間を測る
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "pixel_kernels.h"
+#include "tile_renderer.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+    const unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2]))
+                                         : std::max(1u, std::thread::hardware_concurrency());
+
+    struct Size
+    {
+        const char *name;
+        int width, height;
+    };
+    const std::vector<Size> sizes = {{"320x320", 320, 320}, {"1920x1080", 1920, 1080}, {"3840x2160", 3840, 2160}};
+
+    // 1, 2, 4, ... と倍々に増やし、最後に最大数を必ず含める
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < maxThreads; t *= 2)
+    {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(maxThreads);
+
+    const PixelKernels &kernels = pixelKernels();
+    std::cout << "pixel_kernels=" << kernels.name << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (const auto &size : sizes)
+    {
+        std::vector<uint32_t> buffer(static_cast<size_t>(size.width) * size.height);
+        double baseMs = 0.0;
+
+        for (unsigned threads : threadCounts)
+        {
+            ThreadPool pool(threads);
+            TileRenderer renderer(pool);
+
+            auto renderFrame = [&](uint32_t phase) {
+                renderer.render(size.width, size.height, [&](const Tile &tile) {
+                    kernels.pattern(buffer.data(), size.width, tile.x, tile.y, tile.w, tile.h, phase);
+                });
+            };
+
+            // スレッドの起動やページフォルトを計測から除くためのウォームアップ
+            renderFrame(0);
+
+            const auto start = Clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                renderFrame(static_cast<uint32_t>(i));
+            }
+            const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+            if (threads == 1)
+            {
+                baseMs = ms;
+            }
+
+            std::cout << size.name << " threads=" << std::setw(2) << threads
+                      << " tiles=" << renderer.tileCount()
+                      << " " << std::setw(8) << ms << " ms/frame"
+                      << " " << std::setw(8) << static_cast<double>(buffer.size()) / ms / 1e3 << " Mpix/s"
+                      << " speedup=" << baseMs / ms << "x"
+                      << " steals=" << pool.stealCount() << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
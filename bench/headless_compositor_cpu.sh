@@ -0,0 +1,61 @@
+#!/bin/bash
+# weston（headlessバックエンド）上でクライアントを一定フレーム数だけ実行し、その間にwestonが消費したCPU時間を比較する
+# 不透明領域とアルファなしのフォーマット（XRGB8888 / RGB565）で、コンポジタの合成負荷がどれだけ減るかを確認する
+# 比較対象は --translucent（ARGB8888・不透明領域なし。以前の動作）
+#
+# 使い方: bash bench/headless_compositor_cpu.sh [ビルドディレクトリ(既定: build)] [フレーム数(既定: 600)]
+
+set -eu
+
+BUILD_DIR=${1:-build}
+FRAMES=${2:-600}
+SOCKET=wayland-compositor-cpu-$$
+
+export XDG_RUNTIME_DIR=${XDG_RUNTIME_DIR:-/run/user/$(id -u)}
+mkdir -p "$XDG_RUNTIME_DIR"
+chmod 0700 "$XDG_RUNTIME_DIR"
+
+# EGLクライアントにはGLレンダラ（weston 9以降の--use-gl）が必要。使えない場合はpixmanでshmクライアントのみ計測する
+if weston --help 2>&1 | grep -q -- "--use-gl"; then
+    RENDERER=--use-gl
+else
+    RENDERER=--use-pixman
+fi
+weston --backend=headless-backend.so "$RENDERER" --socket="$SOCKET" --idle-time=0 &
+WESTON_PID=$!
+trap 'kill $WESTON_PID 2>/dev/null || true' EXIT
+
+for _ in $(seq 50); do
+    [ -S "$XDG_RUNTIME_DIR/$SOCKET" ] && break
+    sleep 0.1
+done
+export WAYLAND_DISPLAY=$SOCKET
+
+# westonのユーザー時間+システム時間（ms）。/proc/<pid>/stat の14・15番目のフィールド（クロックティック単位）
+weston_cpu_ms() {
+    awk -v hz="$(getconf CLK_TCK)" '{ printf "%d\n", ($14 + $15) * 1000 / hz }' "/proc/$WESTON_PID/stat"
+}
+
+# 引数のコマンドを実行し、その間のwestonのCPU時間を出力する
+measure() {
+    local label=$1
+    shift
+    local before after
+    before=$(weston_cpu_ms)
+    "$@" > /dev/null
+    after=$(weston_cpu_ms)
+    echo "$label compositor_cpu_ms=$((after - before)) frames=$FRAMES compositor_cpu_ms/frame=$(awk -v t=$((after - before)) -v f="$FRAMES" 'BEGIN { printf "%.3f", t / f }')"
+}
+
+SHM="$BUILD_DIR/my_wayland_client --backend shm --frames $FRAMES"
+measure "[shm argb8888 translucent]" $SHM --translucent
+measure "[shm xrgb8888 opaque]     " $SHM
+measure "[shm rgb565 opaque]       " $SHM --rgb565
+
+if [ "$RENDERER" = --use-gl ]; then
+    EGL="$BUILD_DIR/my_wayland_client --backend egl --frames $FRAMES"
+    measure "[egl alpha translucent]   " $EGL --translucent
+    measure "[egl opaque]              " $EGL
+else
+    echo "[egl] skipped: this weston's headless backend has no GL renderer"
+fi
@@ -0,0 +1,41 @@
+#!/bin/bash
+# weston（headlessバックエンド）上でクライアントを両方のバックエンド（--backend egl/shm）で一定フレーム数だけ実行し、
+# フレーム時間と表示までのレイテンシ（wp_presentation）の統計を出力する
+# 表示環境のないCIでのレイテンシの退行検知に使う
+#
+# 使い方: bash bench/headless_latency.sh [ビルドディレクトリ(既定: build)] [フレーム数(既定: 600)]
+
+set -eu
+
+BUILD_DIR=${1:-build}
+FRAMES=${2:-600}
+SOCKET=wayland-headless-$$
+
+export XDG_RUNTIME_DIR=${XDG_RUNTIME_DIR:-/run/user/$(id -u)}
+mkdir -p "$XDG_RUNTIME_DIR"
+chmod 0700 "$XDG_RUNTIME_DIR"
+
+# headlessバックエンドは出力デバイスなしで動作し、一定間隔（既定60Hz）で合成と表示を行う
+# EGLクライアントにはGLレンダラ（weston 9以降の--use-gl）が必要。使えない場合はpixmanでshmクライアントのみ計測する
+if weston --help 2>&1 | grep -q -- "--use-gl"; then
+    RENDERER=--use-gl
+else
+    RENDERER=--use-pixman
+fi
+weston --backend=headless-backend.so "$RENDERER" --socket="$SOCKET" --idle-time=0 &
+WESTON_PID=$!
+trap 'kill $WESTON_PID 2>/dev/null || true' EXIT
+
+# ソケットが作られるまで待つ
+for _ in $(seq 50); do
+    [ -S "$XDG_RUNTIME_DIR/$SOCKET" ] && break
+    sleep 0.1
+done
+
+export WAYLAND_DISPLAY=$SOCKET
+if [ "$RENDERER" = --use-gl ]; then
+    "$BUILD_DIR/my_wayland_client" --backend egl --frames "$FRAMES"
+else
+    echo "[egl] skipped: this weston's headless backend has no GL renderer"
+fi
+"$BUILD_DIR/my_wayland_client" --backend shm --frames "$FRAMES"
@@ -0,0 +1,53 @@
+#!/bin/bash
+# weston（headlessバックエンド）上でEGLクライアントのウィンドウを1・16・64枚開き、
+# 1ウィンドウあたりのメモリ増加量と描画処理の時間を比較する
+# ウィンドウは1つの接続・EGLコンテキスト・シェーダープログラムを共有する（--windows）
+# ・frame_cost_ms   ：1ウィンドウ1フレームあたりの描画処理の時間（サーフェスの切り替えからeglSwapBuffersが戻るまで）
+# ・rss_per_window_kb：1ウィンドウの場合との常駐メモリ（VmRSS）の差を、増えたウィンドウ数で割ったもの
+#
+# 使い方: bash bench/multi_window.sh [ビルドディレクトリ(既定: build)] [フレーム数(既定: 300)]
+
+set -eu
+
+BUILD_DIR=${1:-build}
+FRAMES=${2:-300}
+SOCKET=wayland-multi-window-$$
+
+export XDG_RUNTIME_DIR=${XDG_RUNTIME_DIR:-/run/user/$(id -u)}
+mkdir -p "$XDG_RUNTIME_DIR"
+chmod 0700 "$XDG_RUNTIME_DIR"
+
+# EGLクライアントにはGLレンダラ（weston 9以降の--use-gl）が必要
+if ! weston --help 2>&1 | grep -q -- "--use-gl"; then
+    echo "[multi-window] skipped: this weston's headless backend has no GL renderer"
+    exit 0
+fi
+weston --backend=headless-backend.so --use-gl --socket="$SOCKET" --idle-time=0 &
+WESTON_PID=$!
+trap 'kill $WESTON_PID 2>/dev/null || true' EXIT
+
+for _ in $(seq 50); do
+    [ -S "$XDG_RUNTIME_DIR/$SOCKET" ] && break
+    sleep 0.1
+done
+export WAYLAND_DISPLAY=$SOCKET
+
+# 「[egl] windows=...」「[egl] diamonds=...」「[egl memory] ...」の行から指定した項目の値を取り出す
+field() {
+    echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+BASE_RSS=
+for WINDOWS in 1 16 64; do
+    SUMMARY=$("$BUILD_DIR/my_wayland_client" --backend egl --windows "$WINDOWS" --frames "$FRAMES" | grep -E '^\[egl( memory)?\] (windows|diamonds|rss_kb)=')
+    RSS=$(field "$SUMMARY" rss_kb)
+    if [ -z "$BASE_RSS" ]; then
+        BASE_RSS=$RSS
+        PER_WINDOW=-
+    else
+        PER_WINDOW=$(( (RSS - BASE_RSS) / (WINDOWS - 1) ))
+    fi
+    echo "[multi-window] windows=$WINDOWS rss_kb=$RSS rss_per_window_kb=$PER_WINDOW" \
+         "frame_cost_ms=$(field "$SUMMARY" frame_cost_ms) fps_total=$(field "$SUMMARY" fps_total)" \
+         "surface_switches=$(field "$SUMMARY" surface_switches)"
+done
@@ -0,0 +1,41 @@
+#!/bin/bash
+# コンポジタなし（--offscreen）でクライアントを両方のバックエンド（--backend egl/shm）で実行して描画のスループットを出力し、
+# 各フレームの画像（PPM）を基準画像とピクセル単位で比較する
+# GPUもWaylandサーバーもないCIで、描画の変更による見た目の退行を検出するために使う
+# （EGL側はMesaのサーフェスレスプラットフォーム。GPUがなければllvmpipeで描画される）
+#
+# 基準画像のディレクトリがまだなければ、今回の画像を基準として保存する
+# ソフトウェアラスタライザとGLでは辺上のピクセルの扱いがわずかに異なるため、基準はクライアントごとに持つ
+#
+# 使い方: bash bench/offscreen_golden.sh <基準画像のディレクトリ> [ビルドディレクトリ(既定: build)] [フレーム数(既定: 120)]
+
+set -eu
+
+GOLDEN_DIR=$1
+BUILD_DIR=${2:-build}
+FRAMES=${3:-120}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+mkdir -p "$OUT/shm" "$OUT/egl"
+
+"$BUILD_DIR/my_wayland_client" --backend shm --offscreen --frames "$FRAMES" --dump "$OUT/shm"
+"$BUILD_DIR/my_wayland_client" --backend egl --offscreen --frames "$FRAMES" --dump "$OUT/egl"
+
+STATUS=0
+for CLIENT in shm egl; do
+    if [ ! -d "$GOLDEN_DIR/$CLIENT" ]; then
+        mkdir -p "$GOLDEN_DIR"
+        cp -r "$OUT/$CLIENT" "$GOLDEN_DIR/$CLIENT"
+        echo "[$CLIENT golden] recorded $FRAMES frames in $GOLDEN_DIR/$CLIENT"
+        continue
+    fi
+    MISMATCH=0
+    for IMAGE in "$OUT/$CLIENT"/*.ppm; do
+        if ! cmp -s "$IMAGE" "$GOLDEN_DIR/$CLIENT/${IMAGE##*/}"; then
+            MISMATCH=$((MISMATCH + 1))
+        fi
+    done
+    echo "[$CLIENT golden] frames=$FRAMES mismatched=$MISMATCH"
+    [ "$MISMATCH" -eq 0 ] || STATUS=1
+done
+exit $STATUS
@@ -0,0 +1,88 @@
+#!/bin/bash
+# weston（headlessバックエンド）上でクライアントを両方のバックエンド（--backend egl/shm）で一定フレーム数だけ実行し、
+# 1フレームあたりのWaylandのリクエスト数（[result]のrequests_per_frame）が上限を超えていないか確認する
+# 上限を超えたバックエンドがあれば終了コード1で終わる（CIでの通信量の回帰の検出に使う）
+# 通信の内訳は各クライアントの「[egl protocol]」「[shm protocol]」の行を参照（src/protocol_stats.h）
+#
+# 使い方: bash bench/protocol_budget.sh [ビルドディレクトリ(既定: build)] [バックエンド=上限 ...(既定: egl=12 shm=10)]
+#   環境変数FRAMESでフレーム数を変えられる（既定: 300）
+#   westonがない、GLレンダラがなくeglを計測できない、またはリクエスト数が得られない（0以下）場合は失敗とする
+#   （計測されないまま通過しないように）
+#   ALLOW_SKIP=1の場合に限り、計測できないものを飛ばして成功とする
+
+set -eu
+
+BUILD_DIR=${1:-build}
+shift || true
+BUDGETS=${*:-"egl=12 shm=10"}
+FRAMES=${FRAMES:-300}
+ALLOW_SKIP=${ALLOW_SKIP:-0}
+SOCKET=wayland-protocol-budget-$$
+
+export XDG_RUNTIME_DIR=${XDG_RUNTIME_DIR:-/run/user/$(id -u)}
+mkdir -p "$XDG_RUNTIME_DIR"
+chmod 0700 "$XDG_RUNTIME_DIR"
+
+if ! command -v weston > /dev/null; then
+    if [ "$ALLOW_SKIP" = 1 ]; then
+        echo "[protocol-budget] skipped: weston is not installed (ALLOW_SKIP=1)"
+        exit 0
+    fi
+    echo "[protocol-budget] FAILED: weston is not installed (set ALLOW_SKIP=1 to skip)"
+    exit 1
+fi
+# EGLクライアントにはGLレンダラ（weston 9以降の--use-gl）が必要
+if weston --help 2>&1 | grep -q -- "--use-gl"; then
+    RENDERER=--use-gl
+else
+    RENDERER=--use-pixman
+fi
+weston --backend=headless-backend.so "$RENDERER" --socket="$SOCKET" --idle-time=0 &
+WESTON_PID=$!
+trap 'kill $WESTON_PID 2>/dev/null || true' EXIT
+
+for _ in $(seq 50); do
+    [ -S "$XDG_RUNTIME_DIR/$SOCKET" ] && break
+    sleep 0.1
+done
+export WAYLAND_DISPLAY=$SOCKET
+
+FAILED=0
+for BUDGET in $BUDGETS; do
+    BACKEND=${BUDGET%%=*}
+    LIMIT=${BUDGET#*=}
+    case $BACKEND in
+        egl)
+            if [ "$RENDERER" != --use-gl ]; then
+                if [ "$ALLOW_SKIP" = 1 ]; then
+                    echo "[protocol-budget] egl skipped: this weston's headless backend has no GL renderer (ALLOW_SKIP=1)"
+                else
+                    echo "[protocol-budget] egl FAILED: this weston's headless backend has no GL renderer (set ALLOW_SKIP=1 to skip)"
+                    FAILED=1
+                fi
+                continue
+            fi
+            OUTPUT=$("$BUILD_DIR/my_wayland_client" --backend egl --protocol-stats --frames "$FRAMES") ;;
+        shm) OUTPUT=$("$BUILD_DIR/my_wayland_client" --backend shm --protocol-stats --frames "$FRAMES") ;;
+        *) echo "unknown backend: $BACKEND" >&2; exit 1 ;;
+    esac
+    echo "$OUTPUT" | grep "^\[$BACKEND protocol\]" || true
+
+    VALUE=$(echo "$OUTPUT" | grep '^\[result\]' | tr ' ' '\n' | sed -n 's/^requests_per_frame=//p')
+    if [ -z "$VALUE" ] || awk -v value="$VALUE" 'BEGIN { exit !(value <= 0) }'; then
+        # 値がない・0以下の場合は、リクエストを数えられていない（上限の確認にならない）
+        REASON="requests_per_frame=${VALUE:-missing} (requests were not measured)"
+        if [ "$ALLOW_SKIP" = 1 ]; then
+            echo "[protocol-budget] $BACKEND skipped: $REASON (ALLOW_SKIP=1)"
+        else
+            echo "[protocol-budget] $BACKEND FAILED: $REASON (set ALLOW_SKIP=1 to skip)"
+            FAILED=1
+        fi
+    elif awk -v value="$VALUE" -v limit="$LIMIT" 'BEGIN { exit !(value > limit) }'; then
+        echo "[protocol-budget] $BACKEND FAILED: requests_per_frame=$VALUE > $LIMIT"
+        FAILED=1
+    else
+        echo "[protocol-budget] $BACKEND ok: requests_per_frame=$VALUE <= $LIMIT"
+    fi
+done
+exit $FAILED
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+// ピクセル単位の矩形（左上原点）
+struct Rect
+{
+    int x = 0, y = 0, w = 0, h = 0;
+
+    bool empty() const { return w <= 0 || h <= 0; }
+    int64_t area() const { return empty() ? 0 : static_cast<int64_t>(w) * h; }
+
+    bool intersects(const Rect &o) const
+    {
+        return !empty() && !o.empty() && x < o.x + o.w && o.x < x + w && y < o.y + o.h && o.y < y + h;
+    }
+
+    Rect intersected(const Rect &o) const
+    {
+        const int x0 = std::max(x, o.x), y0 = std::max(y, o.y);
+        const int x1 = std::min(x + w, o.x + o.w), y1 = std::min(y + h, o.y + o.h);
+        return x1 > x0 && y1 > y0 ? Rect{x0, y0, x1 - x0, y1 - y0} : Rect{};
+    }
+
+    // 両方を含む最小の矩形
+    Rect united(const Rect &o) const
+    {
+        if (empty())
+        {
+            return o;
+        }
+        if (o.empty())
+        {
+            return *this;
+        }
+        const int x0 = std::min(x, o.x), y0 = std::min(y, o.y);
+        const int x1 = std::max(x + w, o.x + o.w), y1 = std::max(y + h, o.y + o.h);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+};
+
+// 1フレーム分の更新領域（ダメージ）を、互いに重ならない少数の矩形として保持する
+// ・重なる矩形は常に結合する（タイルを並列に描画する際、同じピクセルを2つのスレッドが書かないようにするため）
+// ・結合しても余分な面積がほとんど増えない矩形も結合し、矩形の数を減らす
+// ・矩形がmaxRectsを超えたら、結合による面積の増加が最も小さい組から結合していく
+class DamageRegion
+{
+public:
+    static constexpr size_t maxRects = 8;
+
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    const Rect *begin() const { return rects.data(); }
+    const Rect *end() const { return rects.data() + count; }
+
+    void add(Rect rect)
+    {
+        if (rect.empty())
+        {
+            return;
+        }
+
+        // 既存の矩形と重なる、または結合しても無駄の少ない矩形は吸収していく
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (shouldMerge(rects[i], rect))
+                {
+                    rect = rect.united(rects[i]);
+                    rects[i] = rects[--count];
+                    merged = true;
+                    break;
+                }
+            }
+        }
+
+        if (count == maxRects)
+        {
+            mergeCheapestPair(rect);
+            return;
+        }
+        rects[count++] = rect;
+    }
+
+    void add(const DamageRegion &other)
+    {
+        for (const Rect &rect : other)
+        {
+            add(rect);
+        }
+    }
+
+    // 全ての矩形を含む最小の矩形
+    Rect bounds() const
+    {
+        Rect result;
+        for (const Rect &rect : *this)
+        {
+            result = result.united(rect);
+        }
+        return result;
+    }
+
+    int64_t area() const
+    {
+        int64_t result = 0;
+        for (const Rect &rect : *this)
+        {
+            result += rect.area();
+        }
+        return result;
+    }
+
+private:
+    static bool shouldMerge(const Rect &a, const Rect &b)
+    {
+        if (a.intersects(b))
+        {
+            return true;
+        }
+        // 結合後の面積が元の合計の1.25倍以内なら結合する（隣接・近接した矩形）
+        return a.united(b).area() * 4 <= (a.area() + b.area()) * 5;
+    }
+
+    // rectを追加する余地を作るため、結合時の面積の増加が最小になる組を結合する
+    void mergeCheapestPair(const Rect &rect)
+    {
+        rects[count] = rect;
+        const size_t n = count + 1;
+        size_t bestI = 0, bestJ = 1;
+        int64_t bestCost = INT64_MAX;
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = i + 1; j < n; ++j)
+            {
+                const int64_t cost = rects[i].united(rects[j]).area() - rects[i].area() - rects[j].area();
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        const Rect mergedRect = rects[bestI].united(rects[bestJ]);
+
+        // 結合した2つを取り除いてから入れ直す（結合後の矩形が他と重なった場合も吸収される）
+        size_t remaining = n;
+        rects[bestJ] = rects[--remaining];
+        rects[bestI] = rects[--remaining];
+        count = remaining;
+        add(mergedRect);
+    }
+
+    std::array<Rect, maxRects + 1> rects;
+    size_t count = 0;
+};
+
+// 直近のフレームのダメージ履歴
+// バッファエイジ（そのバッファに最後に描画したのが何フレーム前か）から、
+// バッファの内容を最新にするために描き直す必要がある領域を求める
+class DamageHistory
+{
+public:
+    static constexpr size_t depth = 4;
+
+    // 今回のフレームのダメージを記録する
+    void push(const DamageRegion &frameDamage)
+    {
+        head = (head + 1) % depth;
+        history[head] = frameDamage;
+        filled = std::min(filled + 1, depth);
+    }
+
+    // age フレーム前の内容を持つバッファで描き直すべき領域（今回のフレームを含む直近age個のダメージの和）
+    // ageが0（内容が不定）または履歴より古い場合はfalseを返し、呼び出し側は全体を描き直す
+    bool repaintRegion(uint64_t age, DamageRegion &out) const
+    {
+        out.clear();
+        if (age == 0 || age > filled)
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < age; ++i)
+        {
+            out.add(history[(head + depth - i) % depth]);
+        }
+        return true;
+    }
+
+private:
+    std::array<DamageRegion, depth> history;
+    size_t head = 0;
+    size_t filled = 0;
+};
@@ -0,0 +1,831 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <wayland-client.h>
+#include <wayland-egl.h>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "damage_region.h"
+#include "frame_stats.h"
+#include "gl_geometry.h"
+#include "ppm_image.h"
+#include "program_cache.h"
+#include "renderer.h"
+#include "run_options.h"
+#include "scene.h"
+#include "startup_trace.h"
+
+// EGL+OpenGL ESの描画バックエンド（--backend egl）
+// EGLディスプレイ・コンテキスト・シェーダープログラム・GPU上の頂点データを持ち、すべてのウィンドウで共有する
+// ウィンドウごとに持つのはEGLサーフェスだけ（EglRenderTarget）なので、ウィンドウを増やしても
+// コンテキストの作成やシェーダーのコンパイルは1回で済む
+// 同じコンテキストを複数のEGLサーフェスで使い回すため、各ウィンドウは描画の前にmakeCurrentで自分のサーフェスに切り替える
+class EglRenderer : public Renderer
+{
+public:
+    explicit EglRenderer(const RunOptions &runOptions) : options(runOptions) {}
+
+    // 描画先はすべてこれより先に破棄すること
+    ~EglRenderer() override
+    {
+        if (eglSetup.valid())
+        {
+            eglSetup.wait();
+        }
+        // GLのオブジェクトはコンテキストが有効な間に破棄する
+        // ウィンドウのサーフェスは破棄済みのため、サーフェスなし（オフスクリーンでpbufferを使う場合はpbuffer）でカレントにする
+        // EGL_KHR_surfaceless_contextがなくカレントにできない場合は、GLの関数を呼ばずにラッパーだけを手放す
+        // （GLのオブジェクトはeglTerminateでコンテキストと一緒に解放される）
+        const bool glCurrent = eglContext != EGL_NO_CONTEXT &&
+                               (pbufferSurface != EGL_NO_SURFACE || hasEglExtension("EGL_KHR_surfaceless_context")) &&
+                               eglMakeCurrent(eglDisplay, pbufferSurface, pbufferSurface, eglContext) == EGL_TRUE;
+        if (glCurrent)
+        {
+            diamonds.reset();
+            instanceStream.reset();
+            diamondMesh.reset();
+            glDeleteProgram(programObject);
+        }
+        else
+        {
+            diamonds.release();
+            instanceStream.release();
+            diamondMesh.release();
+        }
+        if (eglDisplay != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (pbufferSurface != EGL_NO_SURFACE)
+            {
+                eglDestroySurface(eglDisplay, pbufferSurface);
+            }
+            eglTerminate(eglDisplay);
+        }
+    }
+
+    EglRenderer(const EglRenderer &) = delete;
+    EglRenderer &operator=(const EglRenderer &) = delete;
+
+    const char *name() const override { return "egl"; }
+
+    std::string sceneName() const override
+    {
+        return options.stressCount == 0 ? "diamond" : "stress" + std::to_string(options.stressCount);
+    }
+
+    // 今回はWaylandに対してEGL+OpenGLを利用した。
+    // もしEGLを利用せずにWayland環境で何かを描画したい場合、Waylandのプロトコルを直接利用する必要がある。
+    // 例）WaylandクライアントはWaylandプロトコルを使用してサーフェスを作成し、そこに直接ピクセルデータを書き込むことで描画
+    // しかし、上記ではOpenGLを使った3Dグラフィックスや高度な2Dグラフィックスのレンダリングには適していない。
+    // 全てWaylandプロトコルで実装する方法はshm_renderer.hで検討
+    //
+    // 起動処理のうち、互いに依存しない2つの流れを並行して進める
+    // ・ワーカースレッド：EGLの初期化・コンフィグ選択・コンテキスト作成・シェーダーと頂点データの準備
+    // ・メインスレッド　：レジストリの取得（ラウンドトリップ1回）と最初のウィンドウのサーフェスの作成
+    // wl_surfaceを必要とするEGLウィンドウサーフェスの作成だけが、両方の完了を待つ（waitForContext）
+    // EGLのバッファはwl_shmを使わないため、対応フォーマットの一覧は待たない（needsShmFormatsは既定のfalse）
+    void connect(wl_display *wlDisplay) override
+    {
+        eglSetup = std::async(std::launch::async, [this, wlDisplay] { initEGLContext(wlDisplay); });
+    }
+
+    std::unique_ptr<RenderTarget> createTarget(WaylandConnection::Globals &globals, wl_surface *surface,
+                                               int width, int height) override;
+
+    void report(std::ostream &os, uint64_t frames) const override
+    {
+        os << "[egl] diamonds=" << diamondCount()
+           << " draw_calls/frame=" << (frames == 0 ? 0.0 : static_cast<double>(diamonds->drawCallCount()) / frames)
+           << " stream_orphans=" << instanceStream->orphans()
+           << " surface_switches=" << surfaceSwitches << std::endl;
+    }
+
+    void runOffscreen(int width, int height) override
+    {
+        initOffscreen();
+        prepareGL();
+
+        // 描画先はRGBA8のレンダーバッファを持つFBO
+        GLuint framebuffer = 0, color = 0;
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw std::runtime_error("Offscreen framebuffer is incomplete");
+        }
+
+        const uint64_t frames = options.maxFrames != 0 ? options.maxFrames : 600;
+        std::vector<uint8_t> rgba(options.dumpDir.empty() ? 0 : static_cast<size_t>(width) * height * 4);
+        std::vector<float> instances;
+        FrameStats stats;
+        const auto start = FrameStats::Clock::now();
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            drawScene(width, height, scene::diamondCenterX(static_cast<float>(i) / 60.0f), instances);
+            if (!options.dumpDir.empty())
+            {
+                // glReadPixelsは描画の完了を待つため、書き出す場合のスループットは読み出しの時間を含む
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+                const std::string path = ppm_image::framePath(options.dumpDir, "egl", i + 1);
+                if (!ppm_image::writeRgbaBottomUp(path, rgba.data(), width, height))
+                {
+                    throw std::runtime_error("Failed to write " + path);
+                }
+            }
+            stats.frame();
+        }
+        // 発行した描画命令がすべて実行されるまでを計測に含める
+        glFinish();
+        const double seconds = std::chrono::duration<double>(FrameStats::Clock::now() - start).count();
+
+        stats.report(std::cout, "egl offscreen");
+        std::cout << "[egl offscreen] renderer=" << reinterpret_cast<const char *>(glGetString(GL_RENDERER))
+                  << " frames=" << frames
+                  << " fps=" << (seconds > 0.0 ? frames / seconds : 0.0)
+                  << " diamonds=" << diamondCount()
+                  << " draw_calls/frame=" << static_cast<double>(diamonds->drawCallCount()) / frames << std::endl;
+
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+    }
+
+    EGLDisplay egl() const { return eglDisplay; }
+    EGLConfig config() const { return eglConfig; }
+    bool bufferAgeSupported() const { return bufferAge; }
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapWithDamage() const { return swapBuffersWithDamage; }
+    const RunOptions &runOptions() const { return options; }
+
+    // ワーカースレッドでのEGLの準備が終わるまで待つ（2回目以降は何もしない）
+    void waitForContext()
+    {
+        if (!eglSetup.valid())
+        {
+            return;
+        }
+        auto phase = startupTrace().phase("egl_setup_wait");
+        eglSetup.get();
+    }
+
+    // 共有のコンテキストを、surfaceを描画先として呼び出し元のスレッドでカレントにする
+    // 既にカレントの場合は何もしない（ウィンドウが1つならフレームごとの切り替えは発生しない）
+    bool makeCurrent(EGLSurface surface)
+    {
+        if (surface == currentSurface)
+        {
+            return true;
+        }
+        if (eglMakeCurrent(eglDisplay, surface, surface, eglContext) != EGL_TRUE)
+        {
+            return false;
+        }
+        currentSurface = surface;
+        ++surfaceSwitches;
+        return true;
+    }
+
+    // コンテキストを呼び出し元のスレッドから外す（別のスレッドでカレントにする前や、カレントのサーフェスを破棄する前に呼ぶ）
+    void releaseCurrent()
+    {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        currentSurface = EGL_NO_SURFACE;
+    }
+
+    EGLSurface current() const { return currentSurface; }
+
+    // シェーダーと頂点データを用意する（コンテキストがカレントの状態で呼ぶ。2回目以降は何もしない）
+    // サーフェスなしのコンテキストが使えた場合は、ワーカースレッドで準備済み
+    void prepareGL()
+    {
+        if (programReported)
+        {
+            return;
+        }
+        if (!glReady)
+        {
+            initOpenGL();
+            glReady = true;
+        }
+        std::cout << programStatus << std::endl;
+        programReported = true;
+    }
+
+    // OpenGL ES を使用して単純な図形を描画
+    // width x heightは描画先のサイズ（動的解像度が有効な場合は、縮小した描画解像度）
+    // centerXはひし形の中心のx座標で、ひし形を左右に往復させるアニメーションに使用
+    // instancesには今回のフレームのインスタンスデータを書き込む（呼び出し元ごとに使い回す領域）
+    void drawScene(int width, int height, float centerX, std::vector<float> &instances)
+    {
+        // 描画領域のビューポートを設定
+        // glViewport関数は、描画が行われるウィンドウのどの部分に表示されるかを定義する
+        // ここでは、ビューポートを描画先全体に設定
+        glViewport(0, 0, width, height);
+
+        // glClearColorで背景を塗りつぶす色を指定
+        // 背景色を薄い灰色に設定。内容は不透明なのでアルファ値は1（--translucentの場合のみ0.5）
+        glClearColor(0.9f, 0.9f, 0.9f, options.translucent ? 0.5f : 1.0f);
+        // glClearは実際にバッファをその色でクリアする
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // 画に使用するシェーダープログラムを指定
+        // programObjectは、事前にコンパイルとリンクが完了したシェーダープログラムのID（全ウィンドウで共有）
+        glUseProgram(programObject);
+
+        // インスタンスごとのデータ（x方向の移動量, y方向の移動量, 拡大率）を用意する
+        // ひし形の頂点データ自体は起動時にVBOへ転送済みのため、毎フレーム送るのはこの3要素だけ
+        buildInstances(centerX, instances);
+        const GLsizei instanceCount = static_cast<GLsizei>(instances.size() / 3);
+
+        // 頂点データを使用してプリミティブ（ここでは三角形）を描画
+        // GL_TRIANGLE_FANは、最初の頂点を中心として、残りの頂点がそれにファンのように連なる三角形を形成する
+        // これにより、ひし形が2つの三角形から構成される
+        // インスタンス描画では、全てのひし形を1回のglDrawArraysInstancedで描画する
+        if (options.perShapeDraws)
+        {
+            diamonds->drawEach(GL_TRIANGLE_FAN, instances.data(), instanceCount);
+        }
+        else
+        {
+            diamonds->draw(GL_TRIANGLE_FAN, instances.data(), instanceCount);
+        }
+    }
+
+private:
+    RunOptions options;
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLConfig eglConfig = nullptr;
+    EGLContext eglContext = EGL_NO_CONTEXT;
+    // オフスクリーン描画でサーフェスなしのコンテキストが使えない場合に、代わりにカレントにする1x1のpbuffer
+    EGLSurface pbufferSurface = EGL_NO_SURFACE;
+    EGLSurface currentSurface = EGL_NO_SURFACE;
+    uint64_t surfaceSwitches = 0;
+    std::future<void> eglSetup;
+    // ワーカースレッドでシェーダーと頂点データの準備まで済んだかどうか
+    bool glReady = false;
+    bool programReported = false;
+    std::string programStatus;
+    GLuint programObject = 0;
+
+    // ダメージトラッキングに使うEGL拡張の有無（使い方はEglRenderTarget::draw/present）
+    bool bufferAge = false;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage = nullptr;
+
+    // GPU側に置いた頂点データ
+    // ・diamondMesh   ：原点を中心とするひし形の頂点（起動時に一度だけ転送）
+    // ・instanceStream：毎フレームのインスタンスデータを流し込むVBO（全ウィンドウで順に追記する）
+    // ・diamonds      ：上の2つを頂点属性0と1に割り当てたVAO
+    std::unique_ptr<StaticMesh> diamondMesh;
+    std::unique_ptr<StreamBuffer> instanceStream;
+    std::unique_ptr<InstancedMesh> diamonds;
+
+    // 1フレームで描画するひし形の数
+    uint32_t diamondCount() const { return options.stressCount == 0 ? 1 : options.stressCount; }
+
+    // 今回のフレームで描画するひし形の位置と大きさをinstancesに書き込む
+    void buildInstances(float centerX, std::vector<float> &instances) const
+    {
+        if (options.stressCount == 0)
+        {
+            // 通常は画面中央のひし形1つを左右に往復させる
+            instances.assign({centerX, 0.0f, 1.0f});
+            return;
+        }
+
+        // ストレステスト：画面をcolumns x columnsの格子に分け、各マスにひし形を1つずつ置く
+        // 全てのひし形が行ごとに位相をずらして左右に揺れる
+        const uint32_t count = options.stressCount;
+        const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const float cell = 2.0f / columns;
+        const float scale = cell / (2.0f * scene::diamondRadius) * 0.8f;
+        instances.resize(static_cast<size_t>(count) * 3);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t row = i / columns, column = i % columns;
+            const float sway = (row % 2 == 0 ? centerX : -centerX) * cell;
+            instances[i * 3 + 0] = -1.0f + (column + 0.5f) * cell + sway;
+            instances[i * 3 + 1] = 1.0f - (row + 0.5f) * cell;
+            instances[i * 3 + 2] = scale;
+        }
+    }
+
+    // EGLディスプレイの初期化からコンテキストの作成まで（wl_surfaceを必要としない部分）
+    // ワーカースレッドで実行される。EGL_KHR_surfaceless_contextが使える場合は、
+    // サーフェスなしでコンテキストをカレントにしてシェーダーと頂点データの準備まで済ませ、コンテキストを解放して戻る
+    void initEGLContext(wl_display *wlDisplay)
+    {
+        // EGL:Embedded-System Graphics Library
+        // EGLは描画が行われる環境（ウィンドウやディスプレイなど）とグラフィックスAPI（OpenGL等）の間の橋渡しをするAPI
+
+        // EGL設定の属性を定義
+        const EGLint configAttribs[] = {
+            // サーフェスタイプ
+            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+            // カラーバッファサイズ
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            // アルファチャンネルなし（コンポジタにはXRGB8888のバッファとして渡され、合成時のブレンドが不要になる）
+            EGL_ALPHA_SIZE, options.translucent ? 8 : 0,
+            // レンダリングタイプ
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+            EGL_NONE};
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 3, // OpenGL ES 3.0 を使用（VAO・インスタンス描画・glMapBufferRangeのため）
+            EGL_NONE};
+
+        // WaylandディスプレイからEGLディスプレイコネクションを取得
+        // EGL（Mesa）は内部で専用のイベントキューを使ってコンポジタとやり取りするため、
+        // メインスレッドのレジストリのラウンドトリップと同時に進めてもよい
+        {
+            auto phase = startupTrace().phase("egl_initialize");
+            eglDisplay = eglGetDisplay((EGLNativeDisplayType)wlDisplay);
+            assert(eglDisplay != EGL_NO_DISPLAY);                            // EGLディスプレイの取得が成功したことを確認
+            assert(eglInitialize(eglDisplay, nullptr, nullptr) == EGL_TRUE); // EGLディスプレイを初期化し、成功したことを確認
+        }
+
+        // 適切なEGLコンフィグを選択
+        EGLint numConfig;
+        {
+            auto phase = startupTrace().phase("egl_choose_config");
+            // EGL_ALPHA_SIZEの0は「0以上」の意味なので、アルファ付きのコンフィグも候補に含まれる
+            // 候補の中からアルファの有無が要求どおりのものを選ぶ（見つからなければ先頭を使う）
+            EGLConfig configs[32];
+            assert(eglChooseConfig(eglDisplay, configAttribs, configs, 32, &numConfig) == EGL_TRUE);
+            assert(numConfig > 0);
+            eglConfig = configs[0];
+            for (EGLint i = 0; i < numConfig; ++i)
+            {
+                EGLint alphaSize = 0;
+                eglGetConfigAttrib(eglDisplay, configs[i], EGL_ALPHA_SIZE, &alphaSize);
+                if ((alphaSize > 0) == options.translucent)
+                {
+                    eglConfig = configs[i];
+                    break;
+                }
+            }
+        }
+
+        // EGLレンダリングコンテキストを作成
+        // EGLレンダリングコンテキストはOpenGLのレンダリング状態、変数、設定を保持する
+        // このコンテキストは、描画操作の現在の状態を表し、使用中のシェーダー、バインドされているテクスチャ、レンダリング設定などを含む
+        // アプリケーションがグラフィックスAPIを使用してレンダリングを行うとき、
+        // 全コマンドとリソースは特定のコンテキスト内で解釈され、実行されるため、
+        // アプリケーションがレンダリングするには、有効なレンダリングコンテキストが必要
+        // このコンテキストを介してグラフィックスハードウェアとやり取りする。
+        // → EGLレンダリングコンテキストはレンダリングの「方法」や「状態」を保持するもの
+        {
+            auto phase = startupTrace().phase("egl_create_context");
+            eglContext = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, contextAttribs);
+            assert(eglContext != EGL_NO_CONTEXT);
+        }
+
+        // ダメージトラッキングに使うEGL拡張の有無を確認
+        initDamageExtensions();
+
+        // コンテキストはサーフェスと独立しているため、サーフェスなしでカレントにできればシェーダーの準備も先に進められる
+        // 作ったGLのオブジェクトはコンテキストに属するので、後でメインスレッドがカレントにすればそのまま使える
+        if (hasEglExtension("EGL_KHR_surfaceless_context") &&
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext) == EGL_TRUE)
+        {
+            initOpenGL();
+            // 描画前にコマンドを確実に実行させてから、コンテキストをこのスレッドから外す
+            glFinish();
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            glReady = true;
+        }
+        eglReleaseThread();
+    }
+
+    // オフスクリーン描画用のEGLとGLの準備（Waylandは使わない）
+    // EGL_MESA_platform_surfacelessが使える場合は、ウィンドウシステムなしのプラットフォームを使う
+    // （GPUのない環境ではMesaのllvmpipeで描画される）
+    // コンテキストはサーフェスなしでカレントにする。できない場合は1x1のpbufferをカレントにする
+    // 描画先のFBOはrunOffscreenで作る
+    void initOffscreen()
+    {
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+            EGL_NONE};
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 3,
+            EGL_NONE};
+
+        {
+            auto phase = startupTrace().phase("egl_initialize");
+            // EGL_NO_DISPLAYに対する拡張の一覧は、ディスプレイに依存しないクライアント拡張
+            const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+            {
+                eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            }
+            else
+            {
+                eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+            assert(eglDisplay != EGL_NO_DISPLAY);
+            assert(eglInitialize(eglDisplay, nullptr, nullptr) == EGL_TRUE);
+        }
+
+        EGLint numConfig;
+        {
+            auto phase = startupTrace().phase("egl_choose_config");
+            assert(eglChooseConfig(eglDisplay, configAttribs, &eglConfig, 1, &numConfig) == EGL_TRUE);
+            assert(numConfig > 0);
+        }
+        {
+            auto phase = startupTrace().phase("egl_create_context");
+            eglContext = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, contextAttribs);
+            assert(eglContext != EGL_NO_CONTEXT);
+        }
+
+        if (!hasEglExtension("EGL_KHR_surfaceless_context") ||
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext) != EGL_TRUE)
+        {
+            const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            pbufferSurface = eglCreatePbufferSurface(eglDisplay, eglConfig, pbufferAttribs);
+            assert(pbufferSurface != EGL_NO_SURFACE);
+            assert(makeCurrent(pbufferSurface));
+        }
+    }
+
+    // EGLの拡張機能の一覧（空白区切りの文字列）に、指定した拡張が含まれるかを調べる
+    bool hasEglExtension(const char *name) const
+    {
+        const char *extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+        if (!extensions)
+        {
+            return false;
+        }
+        const size_t length = std::strlen(name);
+        for (const char *p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+        {
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void initDamageExtensions()
+    {
+        bufferAge = hasEglExtension("EGL_EXT_buffer_age");
+
+        // KHR版とEXT版は関数の型が同じ
+        if (hasEglExtension("EGL_KHR_swap_buffers_with_damage"))
+        {
+            swapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+        }
+        else if (hasEglExtension("EGL_EXT_swap_buffers_with_damage"))
+        {
+            swapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+        }
+    }
+
+    void initOpenGL()
+    {
+        // 初期のシェーダープログラムのIDを取得
+        // 前回の起動時に保存したプログラムバイナリがあればそれを使い、なければソースからコンパイルして保存する
+        const auto programStart = FrameStats::Clock::now();
+        ProgramCache programCache(vShaderStr, fShaderStr);
+        {
+            auto phase = startupTrace().phase("program_cache_load");
+            programObject = programCache.load();
+        }
+        const bool cacheHit = programObject != 0;
+        if (!cacheHit)
+        {
+            {
+                auto phase = startupTrace().phase("shader_compile_link");
+                programObject = initProgramObject();
+            }
+            auto phase = startupTrace().phase("program_cache_store");
+            programCache.store(programObject);
+        }
+        assert(programObject != 0);
+        if (options.lowMemory)
+        {
+            // 以降はシェーダーをコンパイルしない（必要になればドライバが再び確保する）
+            glReleaseShaderCompiler();
+        }
+        // ワーカースレッドから呼ばれることがあるため、出力はprepareGLでまとめて行う
+        programStatus = std::string("シェーダープログラム準備: ") +
+                        (!programCache.enabled() ? "cache disabled" : cacheHit ? "cache hit" : "cache miss") + " " +
+                        std::to_string(std::chrono::duration<double, std::milli>(FrameStats::Clock::now() - programStart).count()) + "ms";
+
+        // ひし形の頂点データ（原点中心）をVBOに転送する
+        // 実際の位置と大きさは、頂点シェーダーでインスタンスごとのデータ（aInstance）から計算する
+        auto phase = startupTrace().phase("geometry_upload");
+        GLfloat vVertices[scene::diamondVertexCount * 3];
+        scene::diamondVertices(0.0f, vVertices);
+        diamondMesh.reset(new StaticMesh(vVertices, scene::diamondVertexCount));
+
+        // インスタンスデータ用のVBOは、数フレーム分を追記できる大きさで確保しておく
+        instanceStream.reset(new StreamBuffer(64 * 1024));
+        diamonds.reset(new InstancedMesh(*diamondMesh, *instanceStream, 0, 1));
+    }
+
+    // OpenGL ESでシェーダーをロードし、コンパイルするための関数
+    // シェーダーの種類（頂点シェーダーまたはフラグメントシェーダー）とシェーダーのソースコードを引数として受け取り、
+    // コンパイルされたシェーダーのIDを返す
+    GLuint loadShader(GLenum type, const char *shaderSrc)
+    {
+        // 指定されたタイプ（GL_VERTEX_SHADER または GL_FRAGMENT_SHADER）のシェーダーオブジェクトを作成し、
+        // 作成されたシェーダーオブジェクトのIDを返す
+        GLuint shader = glCreateShader(type);
+        assert(shader);
+
+        // glShaderSource関数によって、作成したシェーダーオブジェクトにソースコードを関連付ける
+        // この関数はシェーダーオブジェクト、ソースコードの文字列数、ソースコードの文字列の配列、および各文字列の長さを指定する配列を引数として取る
+        // ここでは、ソースコードが1つの文字列からなるため、文字列の数を1とする。
+        // また最後の引数は各文字列の長さを指定する配列だが、nullptrを指定することで、文字列がnull終端であることを示す
+        glShaderSource(shader, 1, &shaderSrc, nullptr);
+
+        // シェーダーをコンパイル
+        glCompileShader(shader);
+
+        GLint compiled;
+        // コンパイルが成功したかどうかをチェック
+        // glGetShaderiv関数は、指定されたシェーダーオブジェクトの特定のパラメータの値を取得する
+        // ここでは、シェーダーのコンパイル状態（GL_COMPILE_STATUS）を取得し、compiled変数に格納する
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        assert(compiled);
+
+        // コンパイルされたシェーダーのIDを返却
+        return shader;
+    }
+
+    // GLSL（OpenGL Shading Language）という言語を使用
+    // 頂点シェーダーのGLSL
+    // 頂点シェーダーは各頂点に適用されるシェーダーで、頂点の座標変換等を実施し、3Dモデルの各頂点に対して最初に実行されるシェーダー
+    static constexpr char vShaderStr[] =
+        "#version 300 es\n" // GLSLのバージョン(3.0)指定
+        // vPositionという名前の4次元ベクトル（vec4）を定義
+        // 頂点の位置を表すデータで、通常はx, y, zの座標とホモジニアス座標w（通常は1.0が設定）となる
+        "layout(location = 0) in vec4 vPosition;\n"
+        // インスタンスごとのデータ（x, y：移動量、z：拡大率）
+        "layout(location = 1) in vec3 aInstance;\n"
+        "void main() {\n"
+        "    gl_Position = vec4(vPosition.xy * aInstance.z + aInstance.xy, vPosition.z, 1.0);\n" // 頂点位置を出力
+        "}\n";
+
+    // フラグメントシェーダーのGLSL
+    // レンダリングされる各ピクセルに適用されるシェーダーで、ピクセルの最終色を計算する
+    // テクスチャマッピング、ライティング、カラーブレンディングなどを行い、画面に表示される色や質感を決定する
+    static constexpr char fShaderStr[] =
+        "#version 300 es\n"          // GLSLのバージョン(3.0)指定
+        "precision mediump float;\n" // 浮動小数点数の計算精度を指定。mediumpは中程度の精度
+        // fragColorは4成分のベクトル（RGBA色）を保持し、レンダリングされるピクセルの色を示す
+        // outキーワードは変数がシェーダーの出力であることを示す
+        "out vec4 fragColor;\n"
+        "void main() {\n"
+        "    fragColor = vec4(0.0, 0.0, 1.0, 1.0);\n" // 青色を出力
+        "}\n";
+
+    GLuint initProgramObject()
+    {
+        // 頂点シェーダーをロードし、コンパイル
+        GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vShaderStr);
+        // フラグメントシェーダーをロードし、コンパイル
+        GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fShaderStr);
+
+        // 新しいシェーダープログラムのIDを生成
+        // このIDは、シェーダーをリンクして最終的な実行可能なプログラムを作成するために使用する
+        GLuint program = glCreateProgram();
+        assert(program); // プログラムの作成が成功したことを確認
+
+        // 先にコンパイルした頂点シェーダーとフラグメントシェーダーを
+        // シェーダープログラムにアタッチ（関連付け）する。
+        // これにより、これらのシェーダーはリンクのプロセスの一部となる
+        glAttachShader(program, vertexShader);   // 頂点シェーダー
+        glAttachShader(program, fragmentShader); // フラグメントシェーダー
+
+        // リンク後にglGetProgramBinaryでバイナリを取り出せるよう、ドライバに伝えておく（ProgramCacheへの保存用）
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        // アタッチされたシェーダーを使用してシェーダープログラムをリンク
+        // リンクプロセスは、異なるシェーダーのコードを組み合わせて、最終的な実行可能なシェーダープログラムを作成する
+        glLinkProgram(program);
+
+        GLint linked;
+        // シェーダープログラムが正常にリンクされたかどうかをチェックする。
+        // リンクが成功すれば、linkedはGL_TRUEとなる
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        assert(linked);
+
+        // プログラムのIDを返す
+        return program;
+    }
+};
+
+// EGLの描画先：1枚のウィンドウのwl_egl_windowとEGLウィンドウサーフェス、およびそのダメージトラッキングの状態
+// コンテキスト・シェーダーなどはEglRendererのものを使う
+class EglRenderTarget : public RenderTarget
+{
+public:
+    EglRenderTarget(EglRenderer &renderer, wl_surface *surface, int width, int height)
+        : renderer(renderer), options(renderer.runOptions()), renderWidth(width), renderHeight(height)
+    {
+        // wl_surfaceを基に、EGLを使用するためのウィンドウ（wl_egl_window）の作成
+        // EGLは、OpenGL ESや他のグラフィックスAPIとネイティブウィンドウシステム間のインターフェイスを提供する
+        // このwl_egl_windowオブジェクトは、後にEGLコンテキストやサーフェスを作成する際に使用される
+        wlEglWindow = wl_egl_window_create(surface, width, height);
+        assert(wlEglWindow);
+
+        // EGLウィンドウサーフェスを作成
+        // EGLウィンドウサーフェスは画面上のウィンドウや部分的な画面領域を表し、
+        // OpenGL等のレンダリングAPIによって描画されたグラフィックスがここに表示される
+        // → EGLウィンドウサーフェスは、レンダリングの結果が表示される「場所」
+        // ちなみにウィンドウサーフェスは、バックバッファとフロントバッファの間で画像を交換する
+        // ダブルバッファリングメカニズムをサポートしていることが一般的で、画像のちらつきを防ぎながらスムーズなアニメーションや描画が可能となる
+        {
+            auto phase = startupTrace().phase("egl_create_window_surface");
+            eglSurface = eglCreateWindowSurface(renderer.egl(), renderer.config(), (EGLNativeWindowType)wlEglWindow, nullptr);
+            assert(eglSurface != EGL_NO_SURFACE);
+        }
+
+        // 作成したコンテキストとサーフェスをアクティブにし、成功したことを確認
+        assert(renderer.makeCurrent(eglSurface));
+
+        if (options.uncapped)
+        {
+            // eglSwapIntervalに0を指定すると、eglSwapBuffersはコンポジタからのフレームコールバックを待たずに戻る
+            // スワップ間隔はカレントの描画サーフェスに対する設定なので、サーフェスごとに行う
+            eglSwapInterval(renderer.egl(), 0);
+        }
+    }
+
+    ~EglRenderTarget() override
+    {
+        // カレントのサーフェスを破棄する場合は、先にコンテキストから外す
+        if (renderer.current() == eglSurface)
+        {
+            renderer.releaseCurrent();
+        }
+        eglDestroySurface(renderer.egl(), eglSurface);
+        wl_egl_window_destroy(wlEglWindow);
+    }
+
+    EglRenderTarget(const EglRenderTarget &) = delete;
+    EglRenderTarget &operator=(const EglRenderTarget &) = delete;
+
+    bool draw(const Frame &frame) override
+    {
+        // 共有のコンテキストの描画先をこのウィンドウのサーフェスに切り替える（ウィンドウが1つなら何もしない）
+        if (!renderer.makeCurrent(eglSurface))
+        {
+            throw std::runtime_error("eglMakeCurrent failed");
+        }
+
+        // 今回のフレームで変化する領域：移動前と移動後のひし形を含む矩形（描画サイズのバッファ座標）
+        const Rect screen{0, 0, renderWidth, renderHeight};
+        const Rect diamondBounds = scene::diamondBounds(frame.centerX, renderWidth, renderHeight);
+        frameDamage.clear();
+        // ストレステストでは画面全体にひし形が並ぶため、常に全体を更新する
+        if (frame.number == 1 || frame.resized || options.fullDamage || options.stressCount != 0)
+        {
+            frameDamage.add(screen);
+        }
+        else
+        {
+            frameDamage.add(lastDiamondBounds);
+            frameDamage.add(diamondBounds);
+        }
+        lastDiamondBounds = diamondBounds;
+        damageHistory.push(frameDamage);
+
+        // バックバッファの内容が何フレーム前のものかを調べ、それ以降に変化した領域だけを描き直す
+        // エイジが0（内容が不定）の場合や、拡張がない場合は全体を描き直す
+        EGLint age = 0;
+        if (renderer.bufferAgeSupported() && !frame.resized && !options.fullDamage && options.stressCount == 0)
+        {
+            eglQuerySurface(renderer.egl(), eglSurface, EGL_BUFFER_AGE_EXT, &age);
+        }
+        if (!damageHistory.repaintRegion(age, repaintRegion))
+        {
+            repaintRegion.clear();
+            repaintRegion.add(screen);
+        }
+
+        // glScissorは矩形1つしか指定できないため、描き直す領域全体を含む矩形に限定する
+        // GLのウィンドウ座標は左下原点なので、y座標を反転する
+        const Rect scissor = repaintRegion.bounds();
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(scissor.x, renderHeight - scissor.y - scissor.h, scissor.w, scissor.h);
+        renderer.drawScene(renderWidth, renderHeight, frame.centerX, instances);
+        glDisable(GL_SCISSOR_TEST);
+        repaintedPixels += scissor.area();
+        renderedAreaPixels += static_cast<uint64_t>(renderWidth) * renderHeight;
+        return true;
+    }
+
+    // バックバッファの内容を画面に提示する
+    void present() override
+    {
+        // eglSwapBuffers関数は、ダブルバッファリングを使用している場合にバックバッファとフロントバッファを交換する機能を持つ。
+        // この関数をコールすることで、drawによってバックバッファにレンダリングされた内容が画面に表示される
+        // eglDisplayはEGLディスプレイコネクションを、eglSurfaceは描画が行われるサーフェスを示す
+        // 拡張が使える場合は、今回のフレームで変化した領域（左下原点）も合わせて渡す
+        if (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage = renderer.swapWithDamage())
+        {
+            EGLint rects[DamageRegion::maxRects * 4];
+            EGLint numRects = 0;
+            for (const Rect &rect : frameDamage)
+            {
+                rects[numRects * 4 + 0] = rect.x;
+                rects[numRects * 4 + 1] = renderHeight - rect.y - rect.h;
+                rects[numRects * 4 + 2] = rect.w;
+                rects[numRects * 4 + 3] = rect.h;
+                ++numRects;
+            }
+            swapBuffersWithDamage(renderer.egl(), eglSurface, rects, numRects);
+        }
+        else
+        {
+            eglSwapBuffers(renderer.egl(), eglSurface);
+        }
+    }
+
+    // 描画サイズだけを使う。wl_egl_window_resizeの後、次のフレームの描画開始時にEGLが新しいサイズのバッファを確保する
+    void resize(int, int, int newRenderWidth, int newRenderHeight) override
+    {
+        renderWidth = newRenderWidth;
+        renderHeight = newRenderHeight;
+        wl_egl_window_resize(wlEglWindow, renderWidth, renderHeight, 0, 0);
+    }
+
+    // コンテキストはスレッドごとにカレントにするため、スレッドを離れる時は外してEGLのスレッドの状態も解放する
+    void release() override
+    {
+        renderer.releaseCurrent();
+        eglReleaseThread();
+    }
+
+    void report(std::ostream &os) const override
+    {
+        os << "[egl] buffer_age=" << (renderer.bufferAgeSupported() ? "yes" : "no")
+           << " swap_with_damage=" << (renderer.swapWithDamage() ? "yes" : "no")
+           << " repainted=" << repaintedPixelRatio() * 100.0 << "%" << std::endl;
+    }
+
+private:
+    EglRenderer &renderer;
+    const RunOptions &options;
+    // 実際に描画するバッファのサイズ（表示サイズはwp_viewportの拡大先で、ウィンドウが管理する）
+    int renderWidth, renderHeight;
+    wl_egl_window *wlEglWindow = nullptr;
+    EGLSurface eglSurface = EGL_NO_SURFACE;
+
+    // ダメージトラッキング
+    // ・EGL_EXT_buffer_age：バックバッファが何フレーム前の内容を保持しているかを取得し、差分だけを描き直す
+    // ・EGL_KHR/EXT_swap_buffers_with_damage：変化した領域をコンポジタに伝え、合成処理を減らす
+    // 拡張の有無はEGLディスプレイ単位、差分の履歴はサーフェスごと
+    DamageHistory damageHistory;
+    DamageRegion frameDamage;
+    DamageRegion repaintRegion;
+    Rect lastDiamondBounds;
+    uint64_t repaintedPixels = 0;
+    // 各フレームの描画サイズの面積の合計（描き直した割合の分母）
+    uint64_t renderedAreaPixels = 0;
+
+    // 今回のフレームで描画するひし形のインスタンスデータ
+    std::vector<float> instances;
+
+    // 描き直したピクセル数の、全フレームを全体描画した場合に対する割合
+    double repaintedPixelRatio() const
+    {
+        return renderedAreaPixels == 0 ? 0.0 : static_cast<double>(repaintedPixels) / renderedAreaPixels;
+    }
+};
+
+// サーフェスの作成はEGLの準備と並行して進め、EGLウィンドウサーフェスの作成だけがその完了を待つ
+inline std::unique_ptr<RenderTarget> EglRenderer::createTarget(WaylandConnection::Globals &, wl_surface *surface,
+                                                               int width, int height)
+{
+    waitForContext();
+    std::unique_ptr<RenderTarget> target(new EglRenderTarget(*this, surface, width, height));
+    // サーフェスなしのコンテキストが使えなかった場合は、ここでシェーダーの準備を行う
+    prepareGL();
+    return target;
+}
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+// epollによるイベントループ
+// Waylandの接続と、タイマー（timerfd）・シグナル（signalfd）・任意のfdを1つのepoll_waitでまとめて待つ
+// ・Waylandのイベントはwl_display_prepare_read → epoll_wait → wl_display_read_events → wl_display_dispatch_pending の順で処理する
+//   （wl_display_dispatchと違い、ソケットの読み込みと待機をこのループが管理するため、他のfdと同時に待てる。
+//     また、他のスレッドが同じwl_displayから別のイベントキューを読んでいても競合しない）
+// ・送信はepoll_waitの前にまとめてフラッシュし、ソケットが詰まっている場合は書き込み可能になるまで待つ
+// ・quit()は他のスレッドからも呼べる（eventfdでepoll_waitを起こす）
+// ・setDisplayにイベントキューを渡すと、既定のキューの代わりにそのキューをディスパッチする
+//   （描画スレッドが専用のキューでフレームコールバックを受け取る場合など。スレッドごとにEventLoopを用意する）
+class EventLoop
+{
+public:
+    // fdにイベントがあった時に呼ばれる。引数はepollのイベント（EPOLLIN等）
+    using FdHandler = std::function<void(uint32_t events)>;
+    // タイマーの満了時に呼ばれる。引数は前回の呼び出しから満了した回数（処理が遅れた場合は2以上）
+    using TimerHandler = std::function<void(uint64_t expirations)>;
+    using SignalHandler = std::function<void(int signo)>;
+
+    EventLoop()
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0)
+        {
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeFd < 0)
+        {
+            close(epollFd);
+            throw std::runtime_error("Failed to create eventfd");
+        }
+        addSource(wakeFd, EPOLLIN, true, [this](uint32_t) {
+            uint64_t value;
+            while (read(wakeFd, &value, sizeof(value)) > 0)
+            {
+            }
+        });
+    }
+
+    ~EventLoop()
+    {
+        for (auto &entry : sources)
+        {
+            if (entry.second.owned && !entry.second.removed)
+            {
+                close(entry.first);
+            }
+        }
+        close(epollFd);
+    }
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // signalfdで受け取るシグナルをブロックする
+    // ブロックしていないスレッドがあるとシグナルがそちらに配送されてしまうため、スレッドを作る前（main関数の先頭）で呼ぶ
+    static void blockSignals(std::initializer_list<int> signals)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (int signo : signals)
+        {
+            sigaddset(&mask, signo);
+        }
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    }
+
+    // Waylandの接続をこのループで扱う
+    // wlQueueを省略した場合は既定のイベントキューをディスパッチする
+    void setDisplay(wl_display *wlDisplay, wl_event_queue *wlQueue = nullptr)
+    {
+        display = wlDisplay;
+        queue = wlQueue;
+        displayFd = wl_display_get_fd(display);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = displayFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, displayFd, &event) != 0)
+        {
+            throw std::runtime_error("Failed to watch the Wayland display fd");
+        }
+    }
+
+    // 任意のfdを監視する（fdはループが閉じない）。戻り値はremoveSourceに渡すID
+    int addFd(int fd, uint32_t events, FdHandler handler)
+    {
+        return addSource(fd, events, false, std::move(handler));
+    }
+
+    // initialの後に1回目、以降intervalごとに呼ばれるタイマーを追加する（intervalが0なら1回だけ）
+    int addTimer(std::chrono::nanoseconds initial, std::chrono::nanoseconds interval, TimerHandler handler)
+    {
+        const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create timerfd");
+        }
+        // it_valueが0だとタイマーが停止してしまうため、最短1nsにする
+        itimerspec spec{toTimespec(interval), toTimespec(std::max(initial, std::chrono::nanoseconds(1)))};
+        timerfd_settime(fd, 0, &spec, nullptr);
+        return addSource(fd, EPOLLIN, true, [fd, handler](uint32_t) {
+            uint64_t expirations = 0;
+            if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0)
+            {
+                handler(expirations);
+            }
+        });
+    }
+
+    // signalsをsignalfdで受け取る。対象のシグナルは事前にblockSignalsでブロックしておくこと
+    int addSignals(std::initializer_list<int> signals, SignalHandler handler)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (int signo : signals)
+        {
+            sigaddset(&mask, signo);
+        }
+        const int fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create signalfd");
+        }
+        return addSource(fd, EPOLLIN, true, [fd, handler](uint32_t) {
+            signalfd_siginfo info;
+            while (read(fd, &info, sizeof(info)) == sizeof(info))
+            {
+                handler(static_cast<int>(info.ssi_signo));
+            }
+        });
+    }
+
+    // ソースを取り除く（ループが作成したtimerfd/signalfdは閉じる）。ハンドラの中から呼んでもよい
+    void removeSource(int id)
+    {
+        auto it = sources.find(id);
+        if (it == sources.end())
+        {
+            return;
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, id, nullptr);
+        if (it->second.owned)
+        {
+            close(id);
+        }
+        if (dispatching)
+        {
+            // 実行中のハンドラを破棄しないよう、mapからの削除はディスパッチの後で行う
+            it->second.removed = true;
+            removedDuringDispatch = true;
+            return;
+        }
+        sources.erase(it);
+    }
+
+    // quit()が呼ばれるか、Waylandの接続でエラーが起きるまでイベントを処理する
+    // エラーで終了した場合はfalseを返す
+    bool run()
+    {
+        while (running && dispatch(-1))
+        {
+        }
+        return !failed;
+    }
+
+    // 1回分のイベントを処理する。timeoutMsは待機時間（-1で無期限、0で待たない）
+    // Waylandの接続でエラーが起きた場合はfalseを返す
+    bool dispatch(int timeoutMs)
+    {
+        if (failed)
+        {
+            return false;
+        }
+
+        if (display)
+        {
+            // キューに未処理のイベントが残っている間は読み込みの準備ができないため、先に処理する
+            while (prepareRead() != 0)
+            {
+                if (dispatchPending() < 0)
+                {
+                    return fail();
+                }
+            }
+            flushDisplay();
+        }
+
+        epoll_event events[16];
+        int count = epoll_wait(epollFd, events, 16, timeoutMs);
+        if (count < 0)
+        {
+            count = 0;
+        }
+
+        if (display)
+        {
+            // 準備した読み込みは、必ずread_eventsかcancel_readのどちらかで終える
+            uint32_t displayEvents = 0;
+            for (int i = 0; i < count; ++i)
+            {
+                if (events[i].data.fd == displayFd)
+                {
+                    displayEvents = events[i].events;
+                }
+            }
+            if (displayEvents & EPOLLIN)
+            {
+                if (wl_display_read_events(display) < 0)
+                {
+                    return fail();
+                }
+            }
+            else
+            {
+                wl_display_cancel_read(display);
+            }
+            if (displayEvents & (EPOLLERR | EPOLLHUP))
+            {
+                return fail();
+            }
+            if (displayEvents & EPOLLOUT)
+            {
+                flushDisplay();
+            }
+        }
+
+        dispatching = true;
+        for (int i = 0; i < count; ++i)
+        {
+            if (events[i].data.fd == displayFd)
+            {
+                continue;
+            }
+            // 同じ回の前のハンドラで取り除かれたソースは無視する
+            auto it = sources.find(events[i].data.fd);
+            if (it != sources.end() && !it->second.removed)
+            {
+                it->second.handler(events[i].events);
+            }
+        }
+        dispatching = false;
+        if (removedDuringDispatch)
+        {
+            for (auto it = sources.begin(); it != sources.end();)
+            {
+                it = it->second.removed ? sources.erase(it) : std::next(it);
+            }
+            removedDuringDispatch = false;
+        }
+
+        if (display && dispatchPending() < 0)
+        {
+            return fail();
+        }
+        return true;
+    }
+
+    // ループを終了させる。他のスレッドやシグナルのハンドラ（signalfd経由）から呼んでもよい
+    void quit()
+    {
+        running = false;
+        const uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    bool isRunning() const { return running; }
+
+private:
+    struct Source
+    {
+        bool owned;
+        FdHandler handler;
+        bool removed = false;
+    };
+
+    static timespec toTimespec(std::chrono::nanoseconds ns)
+    {
+        return timespec{static_cast<time_t>(ns.count() / 1000000000), static_cast<long>(ns.count() % 1000000000)};
+    }
+
+    int addSource(int fd, uint32_t events, bool owned, FdHandler handler)
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            if (owned)
+            {
+                close(fd);
+            }
+            throw std::runtime_error("Failed to add fd to epoll");
+        }
+        sources[fd] = Source{owned, std::move(handler), false};
+        return fd;
+    }
+
+    // 送信待ちのリクエストを送る。ソケットのバッファが一杯の場合は、書き込み可能になるまでEPOLLOUTも監視する
+    void flushDisplay()
+    {
+        const bool pending = wl_display_flush(display) < 0 && errno == EAGAIN;
+        if (pending != waitingForWrite)
+        {
+            epoll_event event{};
+            event.events = EPOLLIN | (pending ? EPOLLOUT : 0);
+            event.data.fd = displayFd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, displayFd, &event);
+            waitingForWrite = pending;
+        }
+    }
+
+    int prepareRead() { return queue ? wl_display_prepare_read_queue(display, queue) : wl_display_prepare_read(display); }
+    int dispatchPending() { return queue ? wl_display_dispatch_queue_pending(display, queue) : wl_display_dispatch_pending(display); }
+
+    bool fail()
+    {
+        failed = true;
+        running = false;
+        return false;
+    }
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    wl_display *display = nullptr;
+    wl_event_queue *queue = nullptr;
+    int displayFd = -1;
+    bool waitingForWrite = false;
+    bool failed = false;
+    bool dispatching = false;
+    bool removedDuringDispatch = false;
+    std::atomic<bool> running{true};
+    std::unordered_map<int, Source> sources;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// フレームレートとフレーム時間の統計を取るためのクラス
+// frame()をフレームの提示ごとに呼び出し、終了時にreport()で結果を出力する
+class FrameStats
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameStats()
+    {
+        // 計測中にメモリ確保が走らないよう、ある程度の領域を先に確保しておく
+        frameTimesMs.reserve(1 << 16);
+    }
+
+    // 1フレーム分の描画が完了したタイミングで呼び出す
+    void frame()
+    {
+        const auto now = Clock::now();
+        if (frameCount == 0)
+        {
+            start = now;
+        }
+        else
+        {
+            frameTimesMs.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+        }
+        last = now;
+        ++frameCount;
+    }
+
+    uint64_t frames() const { return frameCount; }
+
+    // 直近のフレーム時間（ms）。まだ2フレーム未満の場合は0
+    double lastFrameMs() const { return frameTimesMs.empty() ? 0.0 : frameTimesMs.back(); }
+
+    // 最初のフレームから最後のフレームまでの時間（秒）
+    double elapsedSec() const { return frameCount < 2 ? 0.0 : std::chrono::duration<double>(last - start).count(); }
+
+    double fps() const
+    {
+        const double sec = elapsedSec();
+        return sec > 0.0 ? frameTimesMs.size() / sec : 0.0;
+    }
+
+    // フレーム時間のp（0〜1）パーセンタイル（ms）。呼び出しごとにソートするため、終了時の集計用
+    double percentileMs(double p) const
+    {
+        if (frameTimesMs.empty())
+        {
+            return 0.0;
+        }
+        std::vector<double> sorted(frameTimesMs);
+        std::sort(sorted.begin(), sorted.end());
+        return percentile(sorted, p);
+    }
+
+    void report(std::ostream &os, const char *label) const
+    {
+        if (frameTimesMs.empty())
+        {
+            os << "[" << label << "] frames=" << frameCount << " (統計を出すにはフレーム数が不足)" << std::endl;
+            return;
+        }
+
+        // パーセンタイルの計算はソート済みのコピーに対して行う
+        std::vector<double> sorted(frameTimesMs);
+        std::sort(sorted.begin(), sorted.end());
+
+        const double elapsedSec = std::chrono::duration<double>(last - start).count();
+        double sum = 0.0;
+        for (double t : sorted)
+        {
+            sum += t;
+        }
+
+        os << std::fixed << std::setprecision(3)
+           << "[" << label << "]"
+           << " frames=" << frameCount
+           << " elapsed=" << elapsedSec << "s"
+           << " fps=" << (elapsedSec > 0.0 ? sorted.size() / elapsedSec : 0.0)
+           << " frame_ms(avg=" << sum / sorted.size()
+           << " min=" << sorted.front()
+           << " p50=" << percentile(sorted, 0.50)
+           << " p99=" << percentile(sorted, 0.99)
+           << " max=" << sorted.back() << ")"
+           << std::endl;
+    }
+
+private:
+    static double percentile(const std::vector<double> &sorted, double p)
+    {
+        const size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    uint64_t frameCount = 0;
+    Clock::time_point start;
+    Clock::time_point last;
+    std::vector<double> frameTimesMs;
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <cstring>
+
+// GPU側に置いた頂点データを使って描画するためのクラス群（OpenGL ES 3.0）
+// ・StaticMesh   : 形状が変わらない頂点データ。起動時に一度だけVBOへ転送する
+// ・StreamBuffer : 毎フレーム変わるデータ（インスタンスごとの位置など）を流し込むリングバッファ状のVBO
+// ・InstancedMesh: StaticMeshを、StreamBufferに書いたインスタンスデータの数だけ1回の描画命令で描画する
+// クライアント側の配列をglVertexAttribPointerに渡す方式と違い、ドライバが描画のたびに頂点をコピーする必要がない
+
+// 形状が変わらない頂点データ（x, y, z × vertexCount）を保持するVBO
+class StaticMesh
+{
+public:
+    StaticMesh(const float *vertices, GLsizei vertexCount) : vertexCount(vertexCount)
+    {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        // GL_STATIC_DRAW：一度書き込んだら変更せず、何度も描画に使うことをドライバに伝える
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~StaticMesh()
+    {
+        glDeleteBuffers(1, &vbo);
+    }
+
+    StaticMesh(const StaticMesh &) = delete;
+    StaticMesh &operator=(const StaticMesh &) = delete;
+
+    GLuint id() const { return vbo; }
+    GLsizei count() const { return vertexCount; }
+
+private:
+    GLuint vbo = 0;
+    GLsizei vertexCount;
+};
+
+// 毎フレーム書き換えるデータ用のVBO
+// 前回の書き込みの続きに追記していき、末尾に達したらバッファを丸ごと捨てて（orphaning）先頭から書き直す
+// 追記する範囲はGPUがまだ読んでいない可能性のある範囲と重ならないため、同期なし（UNSYNCHRONIZED）でマップできる
+class StreamBuffer
+{
+public:
+    explicit StreamBuffer(GLsizeiptr capacity) : capacity(capacity)
+    {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~StreamBuffer()
+    {
+        glDeleteBuffers(1, &vbo);
+    }
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    // dataをVBOに書き込み、書き込んだ位置（バイトオフセット）を返す
+    // 呼び出し後、GL_ARRAY_BUFFERにはこのVBOがバインドされた状態になる
+    GLintptr write(const void *data, GLsizeiptr size)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (size > capacity)
+        {
+            // 容量が足りない場合は作り直す（ストレステストでインスタンス数を増やした場合など）
+            capacity = size * 2;
+            glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+            offset = 0;
+            ++orphanCount;
+        }
+        else if (offset + size > capacity)
+        {
+            // 末尾に達したので、古い内容をドライバに手放して先頭から使う
+            glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+            offset = 0;
+            ++orphanCount;
+        }
+
+        void *dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst)
+        {
+            std::memcpy(dst, data, size);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        }
+
+        const GLintptr written = offset;
+        // 次の書き込み位置は、頂点属性のアラインメントに合わせて16バイト境界に揃える
+        offset = (offset + size + 15) & ~static_cast<GLintptr>(15);
+        return written;
+    }
+
+    GLuint id() const { return vbo; }
+    uint64_t orphans() const { return orphanCount; }
+
+private:
+    GLuint vbo = 0;
+    GLsizeiptr capacity;
+    GLintptr offset = 0;
+    uint64_t orphanCount = 0;
+};
+
+// StaticMeshをインスタンス描画するためのVAO
+// 頂点属性 positionAttrib にメッシュの頂点（vec3）、instanceAttrib にインスタンスごとのデータ（vec3）を割り当てる
+class InstancedMesh
+{
+public:
+    InstancedMesh(const StaticMesh &mesh, StreamBuffer &stream, GLuint positionAttrib, GLuint instanceAttrib)
+        : mesh(mesh), stream(stream), instanceAttrib(instanceAttrib)
+    {
+        // VAO（Vertex Array Object）に頂点属性の設定を記録しておき、描画時はバインドするだけで済むようにする
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        // 第1引数は頂点属性のインデックス。シェーダーで定義したlayout(location = 0) in vec4 vPosition;に対応している
+        // 第2引数（3）は、頂点一つあたりのデータ数。3D座標（x, y, z）を使用しているため、3を指定
+        // 第6引数は、VBOがバインドされている場合はVBO内の先頭からのオフセットを表す
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.id());
+        glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(positionAttrib);
+
+        // インスタンスごとのデータは、描画のたびにStreamBuffer内の位置を指定し直す
+        // divisorを1にすると、頂点ごとではなくインスタンスごとに次の要素へ進む
+        glVertexAttribDivisor(instanceAttrib, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~InstancedMesh()
+    {
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    InstancedMesh(const InstancedMesh &) = delete;
+    InstancedMesh &operator=(const InstancedMesh &) = delete;
+
+    // instances（vec3 × count）をストリームに書き込み、1回の描画命令で全インスタンスを描画する
+    void draw(GLenum mode, const float *instances, GLsizei count)
+    {
+        const GLintptr offset = stream.write(instances, count * 3 * sizeof(float));
+
+        glBindVertexArray(vao);
+        glVertexAttribPointer(instanceAttrib, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<const void *>(offset));
+        glEnableVertexAttribArray(instanceAttrib);
+        glDrawArraysInstanced(mode, 0, mesh.count(), count);
+        glBindVertexArray(0);
+        ++drawCalls;
+    }
+
+    // 比較用：インスタンスごとに描画命令を発行する（インスタンスデータは頂点属性の定数値として渡す）
+    void drawEach(GLenum mode, const float *instances, GLsizei count)
+    {
+        glBindVertexArray(vao);
+        glDisableVertexAttribArray(instanceAttrib);
+        for (GLsizei i = 0; i < count; ++i)
+        {
+            glVertexAttrib3f(instanceAttrib, instances[i * 3], instances[i * 3 + 1], instances[i * 3 + 2]);
+            glDrawArrays(mode, 0, mesh.count());
+            ++drawCalls;
+        }
+        glBindVertexArray(0);
+    }
+
+    uint64_t drawCallCount() const { return drawCalls; }
+
+private:
+    const StaticMesh &mesh;
+    StreamBuffer &stream;
+    GLuint vao = 0;
+    GLuint instanceAttrib;
+    uint64_t drawCalls = 0;
+};
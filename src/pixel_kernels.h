@@ -0,0 +1,362 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_KERNELS_X86 1
+#endif
+
+// ソフトウェア描画用のピクセル書き込みカーネル
+// スカラー / SSE2 / AVX2 の実装を用意し、実行時にCPUIDを見て使用するものを選択する
+// どの実装も出力はビット単位で同一になる（bench_pixel_kernelsで検証）
+//
+// 座標系はすべてピクセル単位で、bufferは画像の先頭、pitchは1行あたりのピクセル数（stride / 4）
+struct PixelKernels
+{
+    const char *name;
+
+    // count 個のピクセルを color で塗りつぶす
+    void (*fill)(uint32_t *dst, size_t count, uint32_t color);
+
+    // (x0, y0) から w x h の矩形を color で塗りつぶす
+    void (*fillRect)(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t color);
+
+    // (x0, y0) から w x h の矩形に XOR パターンを書き込む
+    // 各ピクセルは c = ((x + phase) ^ (y + phase)) & 0xff として 0xff000000 | c << 16 | c << 8 | c
+    void (*pattern)(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t phase);
+
+    // ソフトウェアラスタライザ用：最大8x8のブロック内で、3本のエッジ関数が全て正のピクセルを color で塗る
+    // dstはブロック左上のピクセル、e[i]は左上ピクセルでのエッジ関数の値、dx[i]/dy[i]は1ピクセルあたりの増分
+    void (*triangleBlock)(uint32_t *dst, int pitch, int w, int h,
+                          const int32_t *e, const int32_t *dx, const int32_t *dy, uint32_t color);
+
+    // count 個の XRGB8888 ピクセルを RGB565 に変換する（各チャンネルの下位ビットは切り捨て）
+    void (*toRgb565)(uint16_t *dst, const uint32_t *src, size_t count);
+};
+
+namespace pixel_kernels
+{
+    // ---- スカラー実装 ----
+
+    inline void fillScalar(uint32_t *dst, size_t count, uint32_t color)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    inline uint32_t patternPixel(int x, int y, uint32_t phase)
+    {
+        const uint32_t c = ((x + phase) ^ (y + phase)) & 0xff;
+        return (255u << 24) | (c << 16) | (c << 8) | c;
+    }
+
+    inline void patternRowScalar(uint32_t *dst, int x0, int x1, int y, uint32_t phase)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            dst[x] = patternPixel(x, y, phase);
+        }
+    }
+
+    template <void (*Fill)(uint32_t *, size_t, uint32_t)>
+    void fillRectWith(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t color)
+    {
+        for (int y = y0; y < y0 + h; ++y)
+        {
+            Fill(buffer + static_cast<size_t>(y) * pitch + x0, w, color);
+        }
+    }
+
+    inline void patternScalar(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t phase)
+    {
+        for (int y = y0; y < y0 + h; ++y)
+        {
+            patternRowScalar(buffer + static_cast<size_t>(y) * pitch, x0, x0 + w, y, phase);
+        }
+    }
+
+    inline uint16_t rgb565Pixel(uint32_t pixel)
+    {
+        return static_cast<uint16_t>(((pixel >> 8) & 0xf800) | ((pixel >> 5) & 0x07e0) | ((pixel >> 3) & 0x001f));
+    }
+
+    inline void toRgb565Scalar(uint16_t *dst, const uint32_t *src, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] = rgb565Pixel(src[i]);
+        }
+    }
+
+    inline void triangleBlockScalar(uint32_t *dst, int pitch, int w, int h,
+                                    const int32_t *e, const int32_t *dx, const int32_t *dy, uint32_t color)
+    {
+        for (int y = 0; y < h; ++y)
+        {
+            uint32_t *row = dst + static_cast<size_t>(y) * pitch;
+            int32_t e0 = e[0] + y * dy[0];
+            int32_t e1 = e[1] + y * dy[1];
+            int32_t e2 = e[2] + y * dy[2];
+            for (int x = 0; x < w; ++x)
+            {
+                if (e0 > 0 && e1 > 0 && e2 > 0)
+                {
+                    row[x] = color;
+                }
+                e0 += dx[0];
+                e1 += dx[1];
+                e2 += dx[2];
+            }
+        }
+    }
+
+#ifdef PIXEL_KERNELS_X86
+    // ---- SSE2実装（4ピクセル単位）----
+
+    __attribute__((target("sse2"))) inline void fillSse2(uint32_t *dst, size_t count, uint32_t color)
+    {
+        const __m128i v = _mm_set1_epi32(static_cast<int>(color));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+        }
+        fillScalar(dst + i, count - i, color);
+    }
+
+    __attribute__((target("sse2"))) inline void patternSse2(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t phase)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+        const __m128i step = _mm_set1_epi32(4);
+        for (int y = y0; y < y0 + h; ++y)
+        {
+            uint32_t *row = buffer + static_cast<size_t>(y) * pitch;
+            const __m128i vy = _mm_set1_epi32(static_cast<int>(y + phase));
+            __m128i vx = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(x0 + phase)));
+            int x = x0;
+            for (; x + 4 <= x0 + w; x += 4)
+            {
+                const __m128i c = _mm_and_si128(_mm_xor_si128(vx, vy), mask);
+                const __m128i pixel = _mm_or_si128(_mm_or_si128(alpha, c),
+                                                   _mm_or_si128(_mm_slli_epi32(c, 8), _mm_slli_epi32(c, 16)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), pixel);
+                vx = _mm_add_epi32(vx, step);
+            }
+            patternRowScalar(row, x, x0 + w, y, phase);
+        }
+    }
+
+    __attribute__((target("sse2"))) inline void triangleBlockSse2(uint32_t *dst, int pitch, int w, int h,
+                                                                  const int32_t *e, const int32_t *dx, const int32_t *dy, uint32_t color)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vcolor = _mm_set1_epi32(static_cast<int>(color));
+        __m128i step[3], rowStart[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            // 各レーン（x = 0..3）のエッジ関数の値。SSE2には32bit乗算がないため、lane * dx はスカラーで求める
+            rowStart[i] = _mm_add_epi32(_mm_set1_epi32(e[i]), _mm_setr_epi32(0, dx[i], dx[i] * 2, dx[i] * 3));
+            step[i] = _mm_slli_epi32(_mm_set1_epi32(dx[i]), 2);
+        }
+
+        for (int y = 0; y < h; ++y)
+        {
+            uint32_t *row = dst + static_cast<size_t>(y) * pitch;
+            __m128i e0 = rowStart[0], e1 = rowStart[1], e2 = rowStart[2];
+            int x = 0;
+            for (; x + 4 <= w; x += 4)
+            {
+                const __m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(e0, zero), _mm_cmpgt_epi32(e1, zero)),
+                                                     _mm_cmpgt_epi32(e2, zero));
+                const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+                const __m128i pixel = _mm_or_si128(_mm_and_si128(inside, vcolor), _mm_andnot_si128(inside, old));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), pixel);
+                e0 = _mm_add_epi32(e0, step[0]);
+                e1 = _mm_add_epi32(e1, step[1]);
+                e2 = _mm_add_epi32(e2, step[2]);
+            }
+            if (x < w)
+            {
+                // 端数のピクセルは、ブロックの外に書き込まないようスカラーで処理する
+                const int32_t tailE[3] = {_mm_cvtsi128_si32(e0), _mm_cvtsi128_si32(e1), _mm_cvtsi128_si32(e2)};
+                triangleBlockScalar(row + x, pitch, w - x, 1, tailE, dx, dy, color);
+            }
+            for (int i = 0; i < 3; ++i)
+            {
+                rowStart[i] = _mm_add_epi32(rowStart[i], _mm_set1_epi32(dy[i]));
+            }
+        }
+    }
+
+    // 4ピクセル分の変換結果（各32bitレーンの下位16bit）
+    __attribute__((target("sse2"))) inline __m128i rgb565Lanes(__m128i pixel)
+    {
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(pixel, 8), _mm_set1_epi32(0xf800));
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(pixel, 5), _mm_set1_epi32(0x07e0));
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(pixel, 3), _mm_set1_epi32(0x001f));
+        return _mm_or_si128(_mm_or_si128(r, g), b);
+    }
+
+    // 8ピクセル単位
+    // SSE2には符号なしの32→16bitパック（packus_epi32はSSE4.1）がないため、符号拡張してから符号付きでパックする
+    __attribute__((target("sse2"))) inline void toRgb565Sse2(uint16_t *dst, const uint32_t *src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i lo = rgb565Lanes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+            __m128i hi = rgb565Lanes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4)));
+            lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+            hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+        }
+        toRgb565Scalar(dst + i, src + i, count - i);
+    }
+
+    // ---- AVX2実装（8ピクセル単位）----
+
+    __attribute__((target("avx2"))) inline void fillAvx2(uint32_t *dst, size_t count, uint32_t color)
+    {
+        const __m256i v = _mm256_set1_epi32(static_cast<int>(color));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+        }
+        fillScalar(dst + i, count - i, color);
+    }
+
+    __attribute__((target("avx2"))) inline void patternAvx2(uint32_t *buffer, int pitch, int x0, int y0, int w, int h, uint32_t phase)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+        const __m256i step = _mm256_set1_epi32(8);
+        for (int y = y0; y < y0 + h; ++y)
+        {
+            uint32_t *row = buffer + static_cast<size_t>(y) * pitch;
+            const __m256i vy = _mm256_set1_epi32(static_cast<int>(y + phase));
+            __m256i vx = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(x0 + phase)));
+            int x = x0;
+            for (; x + 8 <= x0 + w; x += 8)
+            {
+                const __m256i c = _mm256_and_si256(_mm256_xor_si256(vx, vy), mask);
+                const __m256i pixel = _mm256_or_si256(_mm256_or_si256(alpha, c),
+                                                      _mm256_or_si256(_mm256_slli_epi32(c, 8), _mm256_slli_epi32(c, 16)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(row + x), pixel);
+                vx = _mm256_add_epi32(vx, step);
+            }
+            patternRowScalar(row, x, x0 + w, y, phase);
+        }
+    }
+    __attribute__((target("avx2"))) inline void triangleBlockAvx2(uint32_t *dst, int pitch, int w, int h,
+                                                                  const int32_t *e, const int32_t *dx, const int32_t *dy, uint32_t color)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i vcolor = _mm256_set1_epi32(static_cast<int>(color));
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        // ブロック幅が8未満の場合、はみ出すレーンには書き込まない
+        const __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(w), lane);
+        __m256i rowStart[3], vdy[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            rowStart[i] = _mm256_add_epi32(_mm256_set1_epi32(e[i]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dx[i])));
+            vdy[i] = _mm256_set1_epi32(dy[i]);
+        }
+
+        for (int y = 0; y < h; ++y)
+        {
+            uint32_t *row = dst + static_cast<size_t>(y) * pitch;
+            const __m256i inside = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi32(rowStart[0], zero), _mm256_cmpgt_epi32(rowStart[1], zero)),
+                _mm256_and_si256(_mm256_cmpgt_epi32(rowStart[2], zero), valid));
+            _mm256_maskstore_epi32(reinterpret_cast<int *>(row), inside, vcolor);
+            for (int i = 0; i < 3; ++i)
+            {
+                rowStart[i] = _mm256_add_epi32(rowStart[i], vdy[i]);
+            }
+        }
+    }
+
+    // 16ピクセル単位
+    // packus_epi32は128bitレーンごとにパックするため、結果の並びを64bit単位で入れ替えて元の順序に戻す
+    __attribute__((target("avx2"))) inline void toRgb565Avx2(uint16_t *dst, const uint32_t *src, size_t count)
+    {
+        const __m256i maskR = _mm256_set1_epi32(0xf800);
+        const __m256i maskG = _mm256_set1_epi32(0x07e0);
+        const __m256i maskB = _mm256_set1_epi32(0x001f);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i half[2];
+            for (int j = 0; j < 2; ++j)
+            {
+                const __m256i pixel = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + j * 8));
+                half[j] = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pixel, 8), maskR),
+                                                          _mm256_and_si256(_mm256_srli_epi32(pixel, 5), maskG)),
+                                          _mm256_and_si256(_mm256_srli_epi32(pixel, 3), maskB));
+            }
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(half[0], half[1]), 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+        }
+        toRgb565Sse2(dst + i, src + i, count - i);
+    }
+#endif
+
+    inline const PixelKernels &scalar()
+    {
+        static const PixelKernels kernels = {"scalar", fillScalar, fillRectWith<fillScalar>, patternScalar, triangleBlockScalar,
+                                               toRgb565Scalar};
+        return kernels;
+    }
+
+    // このCPUで実行可能な実装の一覧（先頭ほど低速）
+    inline std::vector<const PixelKernels *> available()
+    {
+        std::vector<const PixelKernels *> result = {&scalar()};
+#ifdef PIXEL_KERNELS_X86
+        static const PixelKernels sse2 = {"sse2", fillSse2, fillRectWith<fillSse2>, patternSse2, triangleBlockSse2,
+                                           toRgb565Sse2};
+        static const PixelKernels avx2 = {"avx2", fillAvx2, fillRectWith<fillAvx2>, patternAvx2, triangleBlockAvx2,
+                                           toRgb565Avx2};
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+        {
+            result.push_back(&sse2);
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            result.push_back(&avx2);
+        }
+#endif
+        return result;
+    }
+}
+
+// 使用するカーネルを返す。初回呼び出し時に一度だけ選択する
+// 環境変数 PIXEL_KERNELS=scalar|sse2|avx2 で実装を固定できる（比較・デバッグ用）
+inline const PixelKernels &pixelKernels()
+{
+    static const PixelKernels &selected = []() -> const PixelKernels & {
+        const auto candidates = pixel_kernels::available();
+        if (const char *forced = std::getenv("PIXEL_KERNELS"))
+        {
+            for (const PixelKernels *kernels : candidates)
+            {
+                if (std::strcmp(kernels->name, forced) == 0)
+                {
+                    return *kernels;
+                }
+            }
+        }
+        return *candidates.back();
+    }();
+    return selected;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 描画結果をバイナリPPM（P6、8bit RGB）で書き出す
+// 依存ライブラリなしで書け、画像の比較（ピクセル単位の差分）にもそのまま使える形式
+namespace ppm_image
+{
+    // rgbは幅width x 高さheightの、行の間に隙間のないRGB（3バイト/ピクセル）
+    inline bool write(const std::string &path, int width, int height, const uint8_t *rgb)
+    {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        const size_t size = static_cast<size_t>(width) * height * 3;
+        const bool ok = std::fwrite(rgb, 1, size, file) == size;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // XRGB8888/ARGB8888（0xAARRGGBB）の画像を書き出す。pitchは1行あたりのピクセル数
+    inline bool writeXrgb(const std::string &path, const uint32_t *pixels, int width, int height, int pitch)
+    {
+        std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+        uint8_t *out = rgb.data();
+        for (int y = 0; y < height; ++y)
+        {
+            const uint32_t *row = pixels + static_cast<size_t>(y) * pitch;
+            for (int x = 0; x < width; ++x)
+            {
+                *out++ = static_cast<uint8_t>(row[x] >> 16);
+                *out++ = static_cast<uint8_t>(row[x] >> 8);
+                *out++ = static_cast<uint8_t>(row[x]);
+            }
+        }
+        return write(path, width, height, rgb.data());
+    }
+
+    // glReadPixels(GL_RGBA, GL_UNSIGNED_BYTE)で読み出した画像を書き出す
+    // GLの画像は左下原点のため、行の順序を反転して左上原点にする
+    inline bool writeRgbaBottomUp(const std::string &path, const uint8_t *rgba, int width, int height)
+    {
+        std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+        uint8_t *out = rgb.data();
+        for (int y = height - 1; y >= 0; --y)
+        {
+            const uint8_t *row = rgba + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; ++x)
+            {
+                *out++ = row[x * 4 + 0];
+                *out++ = row[x * 4 + 1];
+                *out++ = row[x * 4 + 2];
+            }
+        }
+        return write(path, width, height, rgb.data());
+    }
+
+    // dir/label-00001.ppm のようなフレームごとのファイル名
+    inline std::string framePath(const std::string &dir, const char *label, uint64_t frame)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/%s-%05llu.ppm", label, static_cast<unsigned long long>(frame));
+        return dir + name;
+    }
+}
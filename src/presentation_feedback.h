@@ -0,0 +1,276 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <time.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include "presentation-time-client-protocol.h"
+
+// 値をbucketMs刻みの固定長のビンに数えていくヒストグラム
+// 計測中にメモリ確保を行わず、パーセンタイルはビンの境界（上限値）で近似する
+// 範囲を超えた値は最後のビンに数え、最大値は別に保持する
+class LatencyHistogram
+{
+public:
+    static constexpr double bucketMs = 0.1;
+    static constexpr size_t bucketCount = 2500; // 0〜250ms
+
+    void add(double ms)
+    {
+        const size_t index = ms <= 0.0 ? 0 : std::min(static_cast<size_t>(ms / bucketMs), bucketCount - 1);
+        ++buckets[index];
+        ++total;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    uint64_t count() const { return total; }
+    double max() const { return maxMs; }
+
+    // p（0〜1）パーセンタイルの値（ms）。ビンの上限を返す
+    double percentile(double p) const
+    {
+        if (total == 0)
+        {
+            return 0.0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return i == bucketCount - 1 ? maxMs : (i + 1) * bucketMs;
+            }
+        }
+        return maxMs;
+    }
+
+    void report(std::ostream &os, const char *name) const
+    {
+        os << std::fixed << std::setprecision(3)
+           << " " << name << "_ms(p50=" << percentile(0.50)
+           << " p95=" << percentile(0.95)
+           << " p99=" << percentile(0.99)
+           << " max=" << maxMs << ")";
+    }
+
+private:
+    std::array<uint32_t, bucketCount> buckets{};
+    uint64_t total = 0;
+    double maxMs = 0.0;
+};
+
+// wp_presentation（presentation-time プロトコル）で、コミットした内容が実際に画面に表示された時刻を受け取る
+// コミットごとにattach()でフィードバックを要求し、次の値を記録する
+// ・コミットから表示までの時間（latency）
+// ・表示に使われた出力のリフレッシュ間隔（refresh）
+// ・表示されなかったフレーム（discarded）と、表示が間に合わず飛ばされたリフレッシュ（dropped）
+// コンポジタがwp_presentationを提供していない場合は何もしない
+class PresentationFeedback
+{
+public:
+    PresentationFeedback() = default;
+    ~PresentationFeedback() { destroy(); }
+
+    PresentationFeedback(const PresentationFeedback &) = delete;
+    PresentationFeedback &operator=(const PresentationFeedback &) = delete;
+
+    // プロキシを破棄する。wl_display_disconnectより前に呼ぶ必要がある
+    void destroy()
+    {
+        for (Pending &pending : slots)
+        {
+            if (pending.feedback)
+            {
+                wp_presentation_feedback_destroy(pending.feedback);
+                pending.feedback = nullptr;
+            }
+        }
+        if (wrapper)
+        {
+            wl_proxy_wrapper_destroy(wrapper);
+            wrapper = nullptr;
+        }
+        if (presentation)
+        {
+            wp_presentation_destroy(presentation);
+            presentation = nullptr;
+        }
+    }
+
+    // レジストリでwp_presentationが見つかったときに呼ぶ
+    // clock_idイベントはバインド直後に届くため、同じディスパッチの中でリスナーを登録しておく
+    void bind(wl_registry *registry, uint32_t id)
+    {
+        presentation = static_cast<wp_presentation *>(wl_registry_bind(registry, id, &wp_presentation_interface, 1));
+        wp_presentation_add_listener(presentation, &presentationListener, this);
+    }
+
+    bool supported() const { return presentation != nullptr; }
+
+    // フィードバックのイベントを受け取るイベントキューを変更する（nullptrで既定のキューに戻す）
+    // 描画スレッドがコミットし、専用のキューでイベントを処理する場合に使う
+    // 以降のattach()と受信は、そのキューをディスパッチするスレッドからのみ行うこと
+    void setQueue(wl_event_queue *queue)
+    {
+        if (!presentation)
+        {
+            return;
+        }
+        // プロキシそのもののキューを変えると、他のスレッドで処理中のイベントと競合するため、ラッパーを使う
+        if (!wrapper)
+        {
+            wrapper = static_cast<wp_presentation *>(wl_proxy_create_wrapper(presentation));
+        }
+        wl_proxy_set_queue(reinterpret_cast<wl_proxy *>(wrapper), queue);
+    }
+
+    // 次のwl_surface_commitに対するフィードバックを要求する（コミットの直前に呼ぶ）
+    // コミット時刻はコンポジタと同じクロック（clock_idで通知されたもの）で記録する
+    void attach(wl_surface *surface)
+    {
+        if (!presentation)
+        {
+            return;
+        }
+        Pending *pending = nullptr;
+        for (Pending &slot : slots)
+        {
+            if (!slot.feedback)
+            {
+                pending = &slot;
+                break;
+            }
+        }
+        if (!pending)
+        {
+            // 応答が返ってこないまま溜まっている場合は計測を見送る（通常は起こらない）
+            ++untracked;
+            return;
+        }
+        pending->owner = this;
+        pending->commitNs = now();
+        // 作成されるフィードバックは、要求を送ったプロキシ（ラッパー）と同じキューに属する
+        pending->feedback = wp_presentation_feedback(wrapper ? wrapper : presentation, surface);
+        wp_presentation_feedback_add_listener(pending->feedback, &feedbackListener, pending);
+    }
+
+    void report(std::ostream &os, const char *label) const
+    {
+        if (!presentation)
+        {
+            os << "[" << label << "] presentation=unsupported" << std::endl;
+            return;
+        }
+        os << "[" << label << "] presented=" << latency.count()
+           << " discarded=" << discarded
+           << " dropped=" << dropped
+           << " untracked=" << untracked
+           << " vsync=" << vsyncFrames;
+        latency.report(os, "latency");
+        refresh.report(os, "refresh");
+        os << std::endl;
+    }
+
+private:
+    // 応答待ちのフィードバック1件分
+    struct Pending
+    {
+        PresentationFeedback *owner = nullptr;
+        // 生成されたヘッダには同名の関数（wp_presentation_feedback）があるため、型名にはstructを付ける
+        struct wp_presentation_feedback *feedback = nullptr;
+        uint64_t commitNs = 0;
+    };
+
+    uint64_t now() const
+    {
+        timespec ts;
+        clock_gettime(clockId, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    static void clockIdEvent(void *data, wp_presentation *, uint32_t clkId)
+    {
+        static_cast<PresentationFeedback *>(data)->clockId = static_cast<clockid_t>(clkId);
+    }
+
+    static void syncOutput(void *, struct wp_presentation_feedback *, wl_output *) {}
+
+    static void presented(void *data, struct wp_presentation_feedback *feedback, uint32_t tvSecHi, uint32_t tvSecLo,
+                          uint32_t tvNsec, uint32_t refreshNs, uint32_t seqHi, uint32_t seqLo, uint32_t flags)
+    {
+        auto *pending = static_cast<Pending *>(data);
+        PresentationFeedback *self = pending->owner;
+
+        const uint64_t presentNs = ((static_cast<uint64_t>(tvSecHi) << 32) | tvSecLo) * 1000000000ull + tvNsec;
+        const uint64_t seq = (static_cast<uint64_t>(seqHi) << 32) | seqLo;
+        self->latency.add(presentNs > pending->commitNs ? (presentNs - pending->commitNs) / 1e6 : 0.0);
+        if (refreshNs != 0)
+        {
+            self->refresh.add(refreshNs / 1e6);
+        }
+        if (flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC)
+        {
+            ++self->vsyncFrames;
+        }
+
+        // 前回表示されたフレームから、リフレッシュ何回分空いたかで飛ばされたフレームを数える
+        // MSC（seq）を提供しないコンポジタ（headlessバックエンドなど）では、表示時刻の間隔とリフレッシュ間隔から求める
+        if (self->lastPresentNs != 0)
+        {
+            uint64_t intervals = 0;
+            if (seq != 0 && self->lastSeq != 0 && seq > self->lastSeq)
+            {
+                intervals = seq - self->lastSeq;
+            }
+            else if (refreshNs != 0 && presentNs > self->lastPresentNs)
+            {
+                intervals = (presentNs - self->lastPresentNs + refreshNs / 2) / refreshNs;
+            }
+            if (intervals > 1)
+            {
+                self->dropped += intervals - 1;
+            }
+        }
+        self->lastPresentNs = presentNs;
+        self->lastSeq = seq;
+
+        wp_presentation_feedback_destroy(feedback);
+        pending->feedback = nullptr;
+    }
+
+    // 他のコミットで内容が置き換えられたなどの理由で、このコミットの内容が表示されなかった
+    static void discardedEvent(void *data, struct wp_presentation_feedback *feedback)
+    {
+        auto *pending = static_cast<Pending *>(data);
+        ++pending->owner->discarded;
+        wp_presentation_feedback_destroy(feedback);
+        pending->feedback = nullptr;
+    }
+
+    static const wp_presentation_listener presentationListener;
+    static const wp_presentation_feedback_listener feedbackListener;
+
+    wp_presentation *presentation = nullptr;
+    wp_presentation *wrapper = nullptr;
+    clockid_t clockId = CLOCK_MONOTONIC;
+    // 通常、応答待ちは数フレーム分しか溜まらない
+    std::array<Pending, 16> slots;
+
+    LatencyHistogram latency;
+    LatencyHistogram refresh;
+    uint64_t discarded = 0;
+    uint64_t dropped = 0;
+    uint64_t untracked = 0;
+    uint64_t vsyncFrames = 0;
+    uint64_t lastPresentNs = 0;
+    uint64_t lastSeq = 0;
+};
+
+inline const wp_presentation_listener PresentationFeedback::presentationListener = {PresentationFeedback::clockIdEvent};
+inline const wp_presentation_feedback_listener PresentationFeedback::feedbackListener = {
+    PresentationFeedback::syncOutput, PresentationFeedback::presented, PresentationFeedback::discardedEvent};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// 自プロセスのメモリ使用量を/proc/self/status（とsmaps_rollup）から読み取る
+// ウィンドウやバッファを増やした時に、1つあたりどれだけメモリが増えるかを見積もるために使う
+namespace process_memory
+{
+    // pathの「key: <値> kB」の値。項目がない場合（Linux以外や古いカーネルなど）は0
+    inline uint64_t fieldKb(const char *path, const char *key)
+    {
+        std::ifstream file(path);
+        const size_t length = std::strlen(key);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.compare(0, length, key) == 0 && line.size() > length && line[length] == ':')
+            {
+                return std::strtoull(line.c_str() + length + 1, nullptr, 10);
+            }
+        }
+        return 0;
+    }
+
+    inline uint64_t statusKb(const char *key) { return fieldKb("/proc/self/status", key); }
+
+    // 物理メモリ上にある分（VmRSS）
+    inline uint64_t residentKb() { return statusKb("VmRSS"); }
+    // VmRSSの最大値
+    inline uint64_t peakResidentKb() { return statusKb("VmHWM"); }
+    // VmRSSのうち共有メモリ（wl_shmのmemfdや、EGLのバッファ等）の分
+    inline uint64_t sharedResidentKb() { return statusKb("RssShmem"); }
+    // 共有しているページを共有しているプロセス数で割って数えた分（PSS）
+    // 同じクライアントを多数起動した場合に、1つあたりの実際の使用量の目安になる。smaps_rollupはLinux 4.14以降
+    inline uint64_t proportionalKb() { return fieldKb("/proc/self/smaps_rollup", "Pss"); }
+}
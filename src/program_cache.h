@@ -0,0 +1,197 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// リンク済みシェーダープログラムのバイナリをディスクにキャッシュする
+// 2回目以降の起動では、ソースからのコンパイル・リンクの代わりにglProgramBinaryで読み込むだけで済む
+// ・キーはシェーダーのソースとGLの実装（ベンダー・レンダラー・バージョン）のハッシュ
+//   ドライバが更新された場合などはキーが変わり、古いバイナリは使われない
+// ・保存先は $XDG_CACHE_HOME/my-wayland-client（未設定の場合は ~/.cache/my-wayland-client）
+// ・キャッシュが読めない・壊れている・ドライバに拒否された場合は、呼び出し側でソースからコンパイルする
+class ProgramCache
+{
+public:
+    // GLコンテキストが有効な状態で生成する（GL_VENDOR等の取得に必要）
+    ProgramCache(const char *vertexSource, const char *fragmentSource)
+    {
+        uint64_t hash = fnvOffset;
+        hash = fnv1a(hash, vertexSource);
+        hash = fnv1a(hash, fragmentSource);
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const auto *value = reinterpret_cast<const char *>(glGetString(name));
+            hash = fnv1a(hash, value ? value : "");
+        }
+        key = hash;
+
+        // バイナリ形式を1つもサポートしていない実装ではキャッシュを使わない
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats > 0)
+        {
+            path = cacheDirectory();
+        }
+        if (!path.empty())
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+            path += name;
+        }
+    }
+
+    bool enabled() const { return !path.empty(); }
+    const std::string &getPath() const { return path; }
+
+    // キャッシュからプログラムを作成する。使えるキャッシュがない場合は0を返す
+    GLuint load() const
+    {
+        if (!enabled())
+        {
+            return 0;
+        }
+
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return 0;
+        }
+        Header header{};
+        std::vector<char> binary;
+        bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == magic && header.key == key;
+        // ヘッダの長さは、確保する前に実際のファイルの大きさと照らし合わせる
+        // （途中で切れた・壊れたファイルの長さをそのまま確保すると、bad_allocで読み込み自体が失敗する）
+        struct stat st{};
+        valid = valid && fstat(fileno(file), &st) == 0 &&
+                static_cast<uint64_t>(st.st_size) == sizeof(header) + static_cast<uint64_t>(header.length);
+        if (valid)
+        {
+            binary.resize(header.length);
+            valid = header.length > 0 && std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        std::fclose(file);
+
+        if (valid)
+        {
+            GLuint program = glCreateProgram();
+            glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+            // ドライバはバイナリを受け付けない場合がある（内部形式の変更など）。その場合はリンク失敗として報告される
+            GLint linked = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            if (linked)
+            {
+                return program;
+            }
+            glDeleteProgram(program);
+        }
+
+        // 使えないキャッシュは削除し、次回の保存で作り直す
+        unlink(path.c_str());
+        return 0;
+    }
+
+    // リンク済みのプログラムのバイナリを保存する
+    // プログラムはリンク前にGL_PROGRAM_BINARY_RETRIEVABLE_HINTを設定しておく必要がある
+    bool store(GLuint program) const
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return false;
+        }
+        std::vector<char> binary(length);
+        Header header{magic, key, 0, 0};
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        if (written <= 0)
+        {
+            return false;
+        }
+        header.length = static_cast<uint32_t>(written);
+
+        // 書き込み途中のファイルを他のプロセスが読まないよう、一時ファイルに書いてからrenameで置き換える
+        const std::string temporary = path + ".tmp." + std::to_string(getpid());
+        FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(binary.data(), 1, header.length, file) == header.length;
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint64_t key;
+        GLenum format;
+        uint32_t length;
+    };
+
+    static constexpr uint32_t magic = 0x3143504d; // "MPC1"
+    static constexpr uint64_t fnvOffset = 0xcbf29ce484222325ull;
+    static constexpr uint64_t fnvPrime = 0x100000001b3ull;
+
+    // FNV-1a（終端の'\0'も含め、文字列の区切りが変わると別のハッシュになるようにする）
+    static uint64_t fnv1a(uint64_t hash, const char *text)
+    {
+        do
+        {
+            hash ^= static_cast<unsigned char>(*text);
+            hash *= fnvPrime;
+        } while (*text++);
+        return hash;
+    }
+
+    // キャッシュの保存先ディレクトリを作成して返す。作成できない場合は空文字列
+    static std::string cacheDirectory()
+    {
+        std::string base;
+        if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        {
+            base = xdg;
+        }
+        else if (const char *home = std::getenv("HOME"); home && *home)
+        {
+            base = std::string(home) + "/.cache";
+        }
+        else
+        {
+            return {};
+        }
+
+        const std::string directory = base + "/my-wayland-client";
+        for (const std::string &dir : {base, directory})
+        {
+            if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+            {
+                return {};
+            }
+        }
+        return directory;
+    }
+
+    uint64_t key = 0;
+    std::string path;
+};
@@ -0,0 +1,636 @@
+// Waylandプロトコルの通信量の計測（protocol_stats.h）と、そのためのフック
+//
+// 実行ファイルで次の関数を定義し、libwayland-clientやEGLの実装（Mesa）からの呼び出しを横取りする
+// （実行ファイルのシンボルは共有ライブラリより先に解決されるため。CMakeではENABLE_EXPORTSで動的シンボルとして公開している）
+// 数えた後は、dlsym(RTLD_NEXT)で得た本来の関数を呼ぶ（計測が無効の場合は、数えずに呼ぶだけ）
+// ・sendmsg / recvmsg：接続のソケットへの送受信（libwayland-clientはこれで読み書きする）
+//   リクエストとイベントは、どちらもワイヤ上のメッセージのヘッダから数える
+// ・wl_proxy_marshal_flags / wl_proxy_marshal_array_flags（libwayland 1.20以降）、
+//   wl_proxy_marshal_constructor_versioned / wl_proxy_marshal_array_constructor_versioned（1.20より前）：
+//   リクエストで作ったオブジェクトのIDとインターフェースの記録のみ（インターフェースごとの内訳用）
+//   ワイヤ上ではインターフェースが分からないwl_registry.bindのためで、数えるのには使わない
+//   （libwayland内部からの呼び出しは、-Bsymbolic-functionsでビルドされていると横取りできないため）
+// ・wl_display_flush / wl_display_roundtrip(_queue)：呼び出し回数と、ラウンドトリップの待ち時間
+#include "protocol_stats.h"
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+// 1つのリクエストの引数の最大数（libwayland-clientのWL_CLOSURE_MAX_ARGSと同じ）
+constexpr int maxArguments = 20;
+
+// 本来の関数（共有ライブラリ側の定義）
+template <typename Function>
+Function next(const char *name)
+{
+    return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+// プロキシのインターフェース
+// wl_proxyは先頭がwl_object（interface, implementation, id）で、libwayland 1.0から変わっていない
+// 公開APIにはインターフェースを返す関数がない（wl_proxy_get_classは名前のみ）ため、直接読む
+const wl_interface *proxyInterface(wl_proxy *proxy)
+{
+    return *reinterpret_cast<const wl_interface *const *>(proxy);
+}
+
+// 可変長引数を、シグネチャに従ってwl_argumentの配列にする（libwayland-clientのwl_argument_from_va_listと同じ）
+// 「?」（nullable）とバージョンの数字は引数ではない
+void argumentsFromVaList(const char *signature, wl_argument *args, va_list ap)
+{
+    int count = 0;
+    for (const char *c = signature; *c && count < maxArguments; ++c)
+    {
+        switch (*c)
+        {
+        case 'i':
+            args[count++].i = va_arg(ap, int32_t);
+            break;
+        case 'u':
+            args[count++].u = va_arg(ap, uint32_t);
+            break;
+        case 'f':
+            args[count++].f = va_arg(ap, wl_fixed_t);
+            break;
+        case 's':
+            args[count++].s = va_arg(ap, const char *);
+            break;
+        case 'o':
+        case 'n':
+            args[count++].o = va_arg(ap, wl_object *);
+            break;
+        case 'a':
+            args[count++].a = va_arg(ap, wl_array *);
+            break;
+        case 'h':
+            args[count++].h = va_arg(ap, int32_t);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// msghdrの制御メッセージ（SCM_RIGHTS）で渡されたfdの数
+uint64_t countFds(const msghdr *msg)
+{
+    uint64_t fds = 0;
+    for (const cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(msg), const_cast<cmsghdr *>(cmsg)))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            fds += (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        }
+    }
+    return fds;
+}
+
+uint32_t readWord(const uint8_t *p)
+{
+    uint32_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+const char *messageName(const wl_interface *interface, uint32_t opcode, bool event)
+{
+    if (!interface)
+    {
+        return nullptr;
+    }
+    const int count = event ? interface->event_count : interface->method_count;
+    const wl_message *messages = event ? interface->events : interface->methods;
+    return opcode < static_cast<uint32_t>(count) ? messages[opcode].name : nullptr;
+}
+
+// wl_display_roundtripはwl_display_roundtrip_queueを呼ぶため、入れ子の呼び出しは数えない
+thread_local int roundtripDepth = 0;
+
+template <typename Call>
+int timedRoundtrip(Call call)
+{
+    if (roundtripDepth > 0 || !protocolStats().enabled())
+    {
+        return call();
+    }
+    ++roundtripDepth;
+    const auto start = std::chrono::steady_clock::now();
+    const int result = call();
+    --roundtripDepth;
+    protocolStats().onRoundtrip(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return result;
+}
+
+// リクエストを送り、作ったオブジェクトを記録する（WL_MARSHAL_FLAG_DESTROYの場合、送った後はproxyが破棄されている）
+wl_proxy *marshal(wl_proxy *proxy, uint32_t opcode, const wl_interface *interface, uint32_t version, uint32_t flags, wl_argument *args)
+{
+    using MarshalArrayFlags = wl_proxy *(*)(wl_proxy *, uint32_t, const wl_interface *, uint32_t, uint32_t, wl_argument *);
+    static const auto marshalArrayFlags = next<MarshalArrayFlags>("wl_proxy_marshal_array_flags");
+
+    wl_proxy *created = marshalArrayFlags(proxy, opcode, interface, version, flags, args);
+    protocolStats().onProxyCreated(created, interface);
+    return created;
+}
+
+// 1.20より前のlibwaylandでの、オブジェクトを作るリクエスト
+wl_proxy *marshalConstructor(wl_proxy *proxy, uint32_t opcode, wl_argument *args, const wl_interface *interface, uint32_t version)
+{
+    using MarshalArrayConstructor = wl_proxy *(*)(wl_proxy *, uint32_t, wl_argument *, const wl_interface *, uint32_t);
+    static const auto marshalArrayConstructor = next<MarshalArrayConstructor>("wl_proxy_marshal_array_constructor_versioned");
+
+    wl_proxy *created = marshalArrayConstructor(proxy, opcode, args, interface, version);
+    protocolStats().onProxyCreated(created, interface);
+    return created;
+}
+
+uint32_t percentile(std::vector<uint32_t> sorted, double p)
+{
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5))];
+}
+
+void reportPerFrame(std::ostream &os, const char *name, const std::vector<uint32_t> &values)
+{
+    double sum = 0.0;
+    for (uint32_t value : values)
+    {
+        sum += value;
+    }
+    os << " " << name << "(avg=" << sum / values.size()
+       << " p50=" << percentile(values, 0.50)
+       << " p99=" << percentile(values, 0.99)
+       << " max=" << *std::max_element(values.begin(), values.end()) << ")";
+}
+} // namespace
+
+ProtocolStats::Counters &ProtocolStats::Counters::operator+=(const Counters &other)
+{
+    requests += other.requests;
+    events += other.events;
+    bytesOut += other.bytesOut;
+    bytesIn += other.bytesIn;
+    fdsOut += other.fdsOut;
+    fdsIn += other.fdsIn;
+    socketWrites += other.socketWrites;
+    flushCalls += other.flushCalls;
+    roundtrips += other.roundtrips;
+    roundtripMs += other.roundtripMs;
+    return *this;
+}
+
+ProtocolStats::Counters ProtocolStats::Counters::operator-(const Counters &other) const
+{
+    Counters diff = *this;
+    diff.requests -= other.requests;
+    diff.events -= other.events;
+    diff.bytesOut -= other.bytesOut;
+    diff.bytesIn -= other.bytesIn;
+    diff.fdsOut -= other.fdsOut;
+    diff.fdsIn -= other.fdsIn;
+    diff.socketWrites -= other.socketWrites;
+    diff.flushCalls -= other.flushCalls;
+    diff.roundtrips -= other.roundtrips;
+    diff.roundtripMs -= other.roundtripMs;
+    return diff;
+}
+
+ProtocolStats::ProtocolStats()
+{
+    phases.emplace_back("startup", Counters());
+}
+
+void ProtocolStats::enable()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // 計測中にメモリ確保が走らないよう、ある程度の領域を先に確保しておく
+    frameRequests.reserve(1 << 16);
+    frameEvents.reserve(1 << 16);
+    frameBytes.reserve(1 << 16);
+    sending.reserve(4096);
+    receiving.reserve(4096);
+    active.store(true, std::memory_order_relaxed);
+}
+
+void ProtocolStats::attach(wl_display *display)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    socketFd = wl_display_get_fd(display);
+    // wl_displayはID 1で、接続の時点で存在する
+    objects[1] = &wl_display_interface;
+    sending.clear();
+    receiving.clear();
+}
+
+void ProtocolStats::detach()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    socketFd = -1;
+}
+
+void ProtocolStats::setPhase(const char *name)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (phaseIndex = 0; phaseIndex < phases.size(); ++phaseIndex)
+    {
+        if (phases[phaseIndex].first == name)
+        {
+            return;
+        }
+    }
+    phases.emplace_back(name, Counters());
+}
+
+void ProtocolStats::frame()
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    Counters sum;
+    for (const auto &phase : phases)
+    {
+        sum += phase.second;
+    }
+    if (framing)
+    {
+        const Counters delta = sum - lastFrame;
+        frameRequests.push_back(static_cast<uint32_t>(delta.requests));
+        frameEvents.push_back(static_cast<uint32_t>(delta.events));
+        frameBytes.push_back(static_cast<uint32_t>(delta.bytesOut + delta.bytesIn));
+    }
+    framing = true;
+    lastFrame = sum;
+}
+
+ProtocolStats::Counters ProtocolStats::total() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Counters sum;
+    for (const auto &phase : phases)
+    {
+        sum += phase.second;
+    }
+    return sum;
+}
+
+static double average(const std::vector<uint32_t> &values)
+{
+    double sum = 0.0;
+    for (uint32_t value : values)
+    {
+        sum += value;
+    }
+    return values.empty() ? 0.0 : sum / values.size();
+}
+
+double ProtocolStats::requestsPerFrame() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return average(frameRequests);
+}
+
+double ProtocolStats::eventsPerFrame() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return average(frameEvents);
+}
+
+double ProtocolStats::bytesPerFrame() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return average(frameBytes);
+}
+
+void ProtocolStats::report(std::ostream &os, const char *label) const
+{
+    if (!enabled())
+    {
+        os << "[" << label << "] disabled (--protocol-statsで計測する)" << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t requests = 0;
+    for (const auto &phase : phases)
+    {
+        requests += phase.second.requests;
+    }
+    if (requests == 0)
+    {
+        // 接続のソケットへの送信を横取りできていない（静的リンクなど）。0のままの値で回帰チェックを通さないよう知らせる
+        std::cerr << "[" << label << "] warning: --protocol-stats saw no requests; the sendmsg hook is not in effect" << std::endl;
+    }
+    os << std::fixed << std::setprecision(3) << "[" << label << "] frames=" << frameRequests.size();
+    if (frameRequests.empty())
+    {
+        os << " (統計を出すにはフレーム数が不足)";
+    }
+    else
+    {
+        reportPerFrame(os, "requests_per_frame", frameRequests);
+        reportPerFrame(os, "events_per_frame", frameEvents);
+        reportPerFrame(os, "bytes_per_frame", frameBytes);
+    }
+    os << std::endl;
+
+    for (const auto &phase : phases)
+    {
+        const Counters &c = phase.second;
+        os << "[" << label << "] phase=" << phase.first
+           << " requests=" << c.requests
+           << " events=" << c.events
+           << " bytes_out=" << c.bytesOut
+           << " bytes_in=" << c.bytesIn
+           << " fds_out=" << c.fdsOut
+           << " fds_in=" << c.fdsIn
+           << " socket_writes=" << c.socketWrites
+           << " flush_calls=" << c.flushCalls
+           << " roundtrips=" << c.roundtrips
+           << " roundtrip_ms=" << c.roundtripMs << std::endl;
+    }
+
+    reportMessages(os, label, "requests", requestCounts, false);
+    reportMessages(os, label, "events", eventCounts, true);
+}
+
+void ProtocolStats::reportMessages(std::ostream &os, const char *label, const char *kind, const std::map<MessageKey, uint64_t> &counts,
+                                   bool events)
+{
+    // 多い順に並べる
+    std::vector<std::pair<MessageKey, uint64_t>> sorted(counts.begin(), counts.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    os << "[" << label << "] " << kind;
+    for (const auto &entry : sorted)
+    {
+        const wl_interface *interface = entry.first.first;
+        const uint32_t opcode = entry.first.second;
+        const char *name = messageName(interface, opcode, events);
+        os << " " << (interface ? interface->name : "unknown") << ".";
+        if (name)
+        {
+            os << name;
+        }
+        else
+        {
+            os << opcode;
+        }
+        os << "=" << entry.second;
+    }
+    os << std::endl;
+}
+
+void ProtocolStats::onProxyCreated(wl_proxy *created, const wl_interface *interface)
+{
+    if (!enabled() || !created || !interface)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    objects[wl_proxy_get_id(created)] = interface;
+}
+
+void ProtocolStats::onSend(int fd, const msghdr *msg, ssize_t bytes)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd != socketFd || bytes < 0)
+    {
+        return;
+    }
+    Counters &c = current();
+    ++c.socketWrites;
+    c.bytesOut += bytes;
+    c.fdsOut += countFds(msg);
+
+    // 送れなかった残りは、libwayland-clientが次のsendmsgで送り直す
+    size_t remaining = static_cast<size_t>(bytes);
+    for (size_t i = 0; i < msg->msg_iovlen && remaining > 0; ++i)
+    {
+        const size_t size = std::min(remaining, msg->msg_iov[i].iov_len);
+        parseMessages(sending, static_cast<const uint8_t *>(msg->msg_iov[i].iov_base), size, false);
+        remaining -= size;
+    }
+}
+
+void ProtocolStats::onReceive(int fd, const msghdr *msg, ssize_t bytes)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd != socketFd || bytes <= 0)
+    {
+        return;
+    }
+    Counters &c = current();
+    c.bytesIn += bytes;
+    c.fdsIn += countFds(msg);
+
+    size_t remaining = static_cast<size_t>(bytes);
+    for (size_t i = 0; i < msg->msg_iovlen && remaining > 0; ++i)
+    {
+        const size_t size = std::min(remaining, msg->msg_iov[i].iov_len);
+        parseMessages(receiving, static_cast<const uint8_t *>(msg->msg_iov[i].iov_base), size, true);
+        remaining -= size;
+    }
+}
+
+void ProtocolStats::onFlush()
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++current().flushCalls;
+}
+
+void ProtocolStats::onRoundtrip(double ms)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++current().roundtrips;
+    current().roundtripMs += ms;
+}
+
+void ProtocolStats::parseMessages(std::vector<uint8_t> &buffer, const uint8_t *data, size_t size, bool events)
+{
+    buffer.insert(buffer.end(), data, data + size);
+
+    // メッセージのヘッダ：オブジェクトID（32bit）、メッセージ全体のバイト数（上位16bit）とopcode（下位16bit）
+    size_t offset = 0;
+    while (buffer.size() - offset >= 8)
+    {
+        const size_t messageSize = readWord(&buffer[offset + 4]) >> 16;
+        if (messageSize < 8)
+        {
+            // ヘッダとして読めない（途中から送受信した場合など）。残りは捨てる
+            offset = buffer.size();
+            break;
+        }
+        if (buffer.size() - offset < messageSize)
+        {
+            break;
+        }
+        countMessage(&buffer[offset], messageSize, events);
+        offset += messageSize;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + offset);
+}
+
+void ProtocolStats::countMessage(const uint8_t *message, size_t size, bool events)
+{
+    const uint32_t id = readWord(message);
+    const uint32_t opcode = readWord(message + 4) & 0xffff;
+    const auto found = objects.find(id);
+    const wl_interface *interface = found != objects.end() ? found->second : nullptr;
+
+    if (events)
+    {
+        ++current().events;
+        ++eventCounts[{interface, opcode}];
+    }
+    else
+    {
+        ++current().requests;
+        ++requestCounts[{interface, opcode}];
+    }
+    const int count = !interface ? 0 : events ? interface->event_count : interface->method_count;
+    if (opcode >= static_cast<uint32_t>(count))
+    {
+        return;
+    }
+
+    // メッセージで作られたオブジェクト（new_id引数）を、以降のメッセージの宛先として登録する
+    // 型の決まっていないnew_id（wl_registry.bind）は、marshalのフックで登録する
+    const wl_message &signature = events ? interface->events[opcode] : interface->methods[opcode];
+    const uint8_t *p = message + 8;
+    const uint8_t *end = message + size;
+    int argument = 0;
+    for (const char *c = signature.signature; *c; ++c)
+    {
+        if (*c == '?' || std::isdigit(static_cast<unsigned char>(*c)))
+        {
+            continue;
+        }
+        // fd（h）はメッセージの本文ではなく、制御メッセージで渡される
+        if (*c != 'h')
+        {
+            if (end - p < 4)
+            {
+                return;
+            }
+            const uint32_t word = readWord(p);
+            p += 4;
+            if (*c == 's' || *c == 'a')
+            {
+                // 長さ（バイト数）と、4バイト境界に揃えた中身
+                p += (static_cast<size_t>(word) + 3) & ~static_cast<size_t>(3);
+            }
+            else if (*c == 'n' && signature.types[argument])
+            {
+                objects[word] = signature.types[argument];
+            }
+        }
+        ++argument;
+    }
+}
+
+ProtocolStats &protocolStats()
+{
+    // 静的オブジェクトの破棄の後にも、他のライブラリの後始末からsendmsg等が呼ばれうるため、破棄しない
+    static ProtocolStats *stats = new ProtocolStats;
+    return *stats;
+}
+
+extern "C"
+{
+    wl_proxy *wl_proxy_marshal_flags(wl_proxy *proxy, uint32_t opcode, const wl_interface *interface, uint32_t version, uint32_t flags,
+                                     ...)
+    {
+        wl_argument args[maxArguments];
+        va_list ap;
+        va_start(ap, flags);
+        argumentsFromVaList(proxyInterface(proxy)->methods[opcode].signature, args, ap);
+        va_end(ap);
+        return marshal(proxy, opcode, interface, version, flags, args);
+    }
+
+    wl_proxy *wl_proxy_marshal_array_flags(wl_proxy *proxy, uint32_t opcode, const wl_interface *interface, uint32_t version,
+                                           uint32_t flags, wl_argument *args)
+    {
+        return marshal(proxy, opcode, interface, version, flags, args);
+    }
+
+    wl_proxy *wl_proxy_marshal_constructor_versioned(wl_proxy *proxy, uint32_t opcode, const wl_interface *interface,
+                                                     uint32_t version, ...)
+    {
+        wl_argument args[maxArguments];
+        va_list ap;
+        va_start(ap, version);
+        argumentsFromVaList(proxyInterface(proxy)->methods[opcode].signature, args, ap);
+        va_end(ap);
+        return marshalConstructor(proxy, opcode, args, interface, version);
+    }
+
+    wl_proxy *wl_proxy_marshal_array_constructor_versioned(wl_proxy *proxy, uint32_t opcode, wl_argument *args,
+                                                           const wl_interface *interface, uint32_t version)
+    {
+        return marshalConstructor(proxy, opcode, args, interface, version);
+    }
+
+    int wl_display_flush(wl_display *display)
+    {
+        static const auto flush = next<int (*)(wl_display *)>("wl_display_flush");
+        protocolStats().onFlush();
+        return flush(display);
+    }
+
+    int wl_display_roundtrip_queue(wl_display *display, wl_event_queue *queue)
+    {
+        static const auto roundtrip = next<int (*)(wl_display *, wl_event_queue *)>("wl_display_roundtrip_queue");
+        return timedRoundtrip([&] { return roundtrip(display, queue); });
+    }
+
+    int wl_display_roundtrip(wl_display *display)
+    {
+        static const auto roundtrip = next<int (*)(wl_display *)>("wl_display_roundtrip");
+        return timedRoundtrip([&] { return roundtrip(display); });
+    }
+
+    ssize_t sendmsg(int fd, const msghdr *msg, int flags)
+    {
+        static const auto send = next<ssize_t (*)(int, const msghdr *, int)>("sendmsg");
+        const ssize_t bytes = send(fd, msg, flags);
+        protocolStats().onSend(fd, msg, bytes);
+        return bytes;
+    }
+
+    ssize_t recvmsg(int fd, msghdr *msg, int flags)
+    {
+        static const auto receive = next<ssize_t (*)(int, msghdr *, int)>("recvmsg");
+        const ssize_t bytes = receive(fd, msg, flags);
+        protocolStats().onReceive(fd, msg, bytes);
+        return bytes;
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <wayland-client.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Waylandプロトコルの通信量の計測
+// libwayland-clientの関数と、接続のソケットへの送受信（sendmsg/recvmsg）を横取りして数える（protocol_stats.cpp）
+// ・リクエスト：送信したメッセージのヘッダ（オブジェクトID、opcode）から、IDのインターフェースとopcodeごと
+// ・イベント  ：受信したメッセージのヘッダから、同じくIDのインターフェースとopcodeごと
+// ワイヤ上のメッセージを数えるため、libwaylandのバージョンやビルド方法（リクエストの送信関数を横取りできるか）によらない
+// ・送受信したバイト数（ワイヤ上のメッセージ）と、一緒に渡したfdの数、ソケットへの書き込み回数
+// ・ブロッキングのラウンドトリップ（wl_display_roundtrip）の回数と待ち時間、wl_display_flushの呼び出し回数
+//   （flushはlibwayland-client内部からの呼び出しを含むかがビルドによって違う。実際の送信の回数はsocket_writes）
+// EGLの実装（Mesa）が同じ接続で行う通信（wl_bufferの作成など）も含まれる
+//
+// 集計は段階（setPhase: 起動処理のstartupと、描画中のframes）ごとと、フレームごと（frame()の間隔）に行う
+// CIでは「1フレームあたりのリクエスト数」（[result]のrequests_per_frame）の増加を回帰として検出する（bench/protocol_budget.sh）
+//
+// 計測は既定では無効で、クライアントの--protocol-statsでenable()した場合だけ行う
+// 無効の間もフックは横取りしたままだが、ロックを取らずに本来の関数を呼ぶだけになる
+class ProtocolStats
+{
+public:
+    struct Counters
+    {
+        uint64_t requests = 0;
+        uint64_t events = 0;
+        uint64_t bytesOut = 0;
+        uint64_t bytesIn = 0;
+        uint64_t fdsOut = 0;
+        uint64_t fdsIn = 0;
+        uint64_t socketWrites = 0;
+        uint64_t flushCalls = 0;
+        uint64_t roundtrips = 0;
+        double roundtripMs = 0.0;
+
+        Counters &operator+=(const Counters &other);
+        Counters operator-(const Counters &other) const;
+    };
+
+    ProtocolStats();
+
+    // 計測を有効にする。接続（attach）より前に呼ぶ
+    void enable();
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    // wl_display_connectの直後に呼ぶ。これより前と、この接続以外のソケットの通信は数えない
+    void attach(wl_display *display);
+    // wl_display_disconnectの直前に呼ぶ（閉じたソケットの番号が他で再利用されても数えないように）
+    void detach();
+    // これ以降の通信を、nameの段階として数える（最初は"startup"）
+    void setPhase(const char *name);
+    // 1フレーム分のコミットの後に呼ぶ。前回のframe()からの通信量を1フレーム分として記録する
+    void frame();
+
+    Counters total() const;
+    // frame()の間隔あたりのリクエスト数の平均（フレームが2つ未満の場合は0）
+    double requestsPerFrame() const;
+    double eventsPerFrame() const;
+    double bytesPerFrame() const;
+
+    // 無効の場合は「[label] disabled ...」の1行のみ
+    // 有効なのにリクエストを1つも数えられなかった場合は、計測できていないことを標準エラー出力に警告する
+    // [label] frames=... requests_per_frame(avg= p50= p99= max=) ...
+    // [label] phase=startup requests=... （段階ごと）
+    // [label] requests wl_surface.commit=600 ... （多い順）
+    void report(std::ostream &os, const char *label) const;
+
+    // 以下はprotocol_stats.cppのフックから呼ばれる
+    void onProxyCreated(wl_proxy *created, const wl_interface *interface);
+    void onSend(int fd, const msghdr *msg, ssize_t bytes);
+    void onReceive(int fd, const msghdr *msg, ssize_t bytes);
+    void onFlush();
+    void onRoundtrip(double ms);
+
+private:
+    // (インターフェース, opcode)。IDからインターフェースが分からないイベントはinterfaceがnullptr
+    using MessageKey = std::pair<const wl_interface *, uint32_t>;
+
+    Counters &current() { return phases[phaseIndex].second; }
+    // 送受信したバイト列を、メッセージ単位に区切って数える（メッセージは複数のsendmsg/recvmsgにまたがることがある）
+    // bufferは送信か受信の途中のメッセージ、eventsは受信（イベント）の場合true
+    void parseMessages(std::vector<uint8_t> &buffer, const uint8_t *data, size_t size, bool events);
+    void countMessage(const uint8_t *message, size_t size, bool events);
+    static void reportMessages(std::ostream &os, const char *label, const char *kind, const std::map<MessageKey, uint64_t> &counts,
+                               bool events);
+
+    std::atomic<bool> active{false};
+    mutable std::mutex mutex;
+    int socketFd = -1;
+
+    std::vector<std::pair<std::string, Counters>> phases;
+    size_t phaseIndex = 0;
+    std::map<MessageKey, uint64_t> requestCounts;
+    std::map<MessageKey, uint64_t> eventCounts;
+
+    // メッセージの宛先のIDから、インターフェースを引く
+    // 送受信したメッセージで作られたオブジェクト（new_id引数）と、wl_registry.bindで作ったオブジェクトを登録する
+    std::unordered_map<uint32_t, const wl_interface *> objects;
+    // 送信途中・受信途中のメッセージ
+    std::vector<uint8_t> sending;
+    std::vector<uint8_t> receiving;
+
+    // frame()の時点の累計と、フレームごとの量
+    Counters lastFrame;
+    bool framing = false;
+    std::vector<uint32_t> frameRequests;
+    std::vector<uint32_t> frameEvents;
+    std::vector<uint32_t> frameBytes;
+};
+
+// プロセスで1つの計測（フックから参照するため）
+ProtocolStats &protocolStats();
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "wayland_connection.h"
+
+class RenderTarget;
+
+// 描画バックエンド（EGL/GLESのegl_renderer.h、wl_shmのshm_renderer.h）の共通のインターフェース
+// サーフェス・xdg_toplevel・フレームコールバック・入力・統計はウィンドウ（wayland_window.h）が受け持ち、
+// バックエンドはバッファに内容を描画してサーフェスに提示するところだけを受け持つ
+//
+// Rendererはプロセスに1つで、ウィンドウをまたいで共有するもの（EGLのコンテキストとシェーダー、
+// wl_shmのアリーナとスレッドプール）を持つ。ウィンドウごとの描画先はcreateTarget()で作るRenderTarget
+class Renderer
+{
+public:
+    virtual ~Renderer() = default;
+
+    // 出力のラベル・起動時間の記録・オフスクリーン描画の画像のファイル名に使う名前（"egl" / "shm"）
+    virtual const char *name() const = 0;
+    // バックエンドの比較用の要約（[result]）のscene
+    virtual std::string sceneName() const = 0;
+
+    // Waylandに接続した直後、レジストリのグローバルを取得する前に呼ばれる
+    // グローバルを必要としない準備（EGLの初期化）は、ここでグローバルの取得と並行して始めてよい
+    virtual void connect(wl_display *) {}
+    // グローバルの取得で、wl_shmの対応フォーマットの一覧まで待つ必要があるか
+    virtual bool needsShmFormats() const { return false; }
+    // ウィンドウのサーフェスに描画先を作る（width x heightは最初のconfigureで決まった表示サイズ）
+    virtual std::unique_ptr<RenderTarget> createTarget(WaylandConnection::Globals &globals, wl_surface *surface,
+                                                       int width, int height) = 0;
+
+    // 全ウィンドウの描画を終えた後のバックエンド全体の統計（framesは全ウィンドウのフレーム数の合計）
+    virtual void report(std::ostream &os, uint64_t frames) const = 0;
+    // メモリの使用量の行（[<name> memory]）に、バックエンド固有の項目（「 key=value」の並び）を加える
+    virtual void reportMemory(std::ostream &) const {}
+
+    // コンポジタに接続せず、width x heightの画像に指定フレーム数を描画してスループットを出力する
+    // アニメーションの時刻は実時間ではなく60fps固定の刻みで進めるため、実行のたびに同じ画像が得られる（画像の比較用）
+    virtual void runOffscreen(int width, int height) = 0;
+};
+
+// 1枚のウィンドウの描画先
+// フレームごとに draw() → （ウィンドウが表示時刻のフィードバック等を要求）→ present() の順に呼ばれる
+class RenderTarget
+{
+public:
+    // 1フレーム分の描画の指示
+    struct Frame
+    {
+        // 1から始まるフレーム番号（描画を見送ったフレームは数えない）
+        uint64_t number;
+        // ひし形の中心のx座標（正規化デバイス座標）
+        float centerX;
+        // 描画サイズが変わってから最初のフレーム（バッファの内容を使えないため全体を描き直す）
+        bool resized;
+    };
+
+    virtual ~RenderTarget() = default;
+
+    // 1フレーム分を描画し、サーフェスにバッファとダメージを設定する（コミットはまだ）
+    // コンポジタが返却していないバッファしかなく描画を見送った場合はfalse（サーフェスには何も設定しない）
+    virtual bool draw(const Frame &frame) = 0;
+    // 描画した内容をサーフェスにコミットする（EGLではeglSwapBuffersの中で行われる）
+    virtual void present() = 0;
+    // 表示サイズ（サーフェス座標）と、描画サイズ（バッファ。動的解像度で縮小した大きさ）が変わった
+    // 内容は次のdraw()で新しいサイズで描く
+    virtual void resize(int width, int height, int renderWidth, int renderHeight) = 0;
+    // 最後のdraw()が、resize()で指定した表示サイズの内容になっているか（resize-to-commitの計測用）
+    virtual bool sizeCommitted() const { return true; }
+
+    // 描画解像度を下げてwp_viewporterで拡大表示できるか（--frame-budget）
+    virtual bool scalable() const { return true; }
+    // surfaceがこの描画先のサブサーフェスの場合はtrueを返し、offsetXに親サーフェスの座標への変換量を書き込む
+    virtual bool subsurfaceOffset(wl_surface *, double &) const { return false; }
+
+    // 呼び出し元のスレッドでの描画を終える（描画スレッドに移す前と、描画スレッドの終了時に呼ばれる）
+    virtual void release() {}
+    // 描画が止まった（--low-memory）。trim()はさらにRunOptions::idleTrimSec秒止まったまま
+    virtual void idle() {}
+    virtual void trim() {}
+
+    // このウィンドウの描画の統計
+    virtual void report(std::ostream &os) const = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// 描画にかかった時間から、内部の描画解像度（倍率）を段階的に調整する
+// 倍率を下げたバッファに描画し、wp_viewporterでコンポジタに元のサイズへ拡大してもらう（動的解像度）
+// ・倍率は固定の段階（scales）の間でのみ変える。バッファの作り直しは段階が変わった時だけ起こる
+// ・windowフレーム分の平均で判断し、判断のたびに集計をやり直す（変更直後の数フレームで再び変更しない）
+// ・下げるのは平均が予算を超えた時、上げるのは1段上げた場合の予測（面積に比例）が予算のupMargin倍に収まる時
+//   上げ下げの閾値に差を設けることで、2つの段階の間を行き来し続けないようにする（ヒステリシス）
+class ResolutionController
+{
+public:
+    static constexpr float scales[] = {1.0f, 0.85f, 0.7f, 0.5f};
+    static constexpr size_t levelCount = sizeof(scales) / sizeof(scales[0]);
+    static constexpr int window = 30;
+    static constexpr double upMargin = 0.75;
+
+    // budgetMsが0以下の場合は無効（常に倍率1）
+    explicit ResolutionController(double budgetMs = 0.0) : budgetMs(budgetMs) {}
+
+    bool enabled() const { return budgetMs > 0.0; }
+
+    // 1フレーム分の描画時間（ms）を記録する。倍率が変わった場合はtrueを返す
+    bool addFrame(double workMs)
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+        sum += workMs;
+        if (++samples < window)
+        {
+            return false;
+        }
+        const double average = sum / samples;
+        sum = 0.0;
+        samples = 0;
+
+        if (average > budgetMs && level + 1 < levelCount)
+        {
+            ++level;
+            ++changes;
+            return true;
+        }
+        if (level > 0)
+        {
+            const double ratio = scales[level - 1] / scales[level];
+            if (average * ratio * ratio < budgetMs * upMargin)
+            {
+                --level;
+                ++changes;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    float scale() const { return scales[level]; }
+
+    // 表示サイズsizeに対する描画サイズ
+    int scaled(int size) const { return std::max(1, static_cast<int>(std::lround(size * scale()))); }
+
+    uint64_t changeCount() const { return changes; }
+
+private:
+    double budgetMs;
+    size_t level = 0;
+    double sum = 0.0;
+    int samples = 0;
+    uint64_t changes = 0;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 描画バックエンド（--backend）
+enum class Backend
+{
+    // EGL+OpenGL ES（egl_renderer.h）
+    Egl,
+    // wl_shmのバッファにCPUで描画（shm_renderer.h）
+    Shm
+};
+
+// 描画する内容
+enum class Scene
+{
+    // XORパターン（斜めにスクロール）。shmのみ
+    Pattern,
+    // 左右に往復するひし形（scene.h）
+    Diamond
+};
+
+// レンダーループの動作設定（コマンドライン引数の一覧はmain.cppを参照）
+// バックエンド固有の項目は、そのバックエンドを選んだ場合のみ指定できる
+struct RunOptions
+{
+    Backend backend = Backend::Egl;
+    Scene scene = Scene::Diamond;
+    // 0以外の場合、指定フレーム数を描画したら終了する
+    uint64_t maxFrames = 0;
+    // trueの場合はダメージトラッキングを行わず、毎フレーム全体を描き直す（比較用）
+    bool fullDamage = false;
+    // 0より大きい場合、この間隔（秒）で途中経過を出力する
+    double reportIntervalSec = 0.0;
+    // 0以外の場合、メインスレッドで100msごとにこの時間（ms）だけ処理を占有する（イベント処理が重い状況の再現用）
+    int mainBusyMs = 0;
+    // trueの場合は以前の動作（アルファ付きのバッファ・半透明の背景・不透明領域なし）で表示する
+    // コンポジタのアルファブレンドの負荷の比較用
+    bool translucent = false;
+    // 0より大きい場合、描画時間がこの予算（ms）に収まるよう描画解像度を下げ、wp_viewporterで拡大して表示する
+    double frameBudgetMs = 0.0;
+    // trueの場合はコンポジタに接続せず、メモリ上（EGLではFBO）にmaxFrames（0なら600）フレーム描画して終了する
+    bool offscreen = false;
+    // 空でない場合、オフスクリーン描画の各フレームをこのディレクトリにPPMで書き出す
+    std::string dumpDir;
+    // 1つの接続と描画バックエンドを共有して開くウィンドウの数
+    int windows = 1;
+    // trueの場合はアニメーションを止めた状態で起動し、入力があった時だけ再描画する（スペースキーで切り替え）
+    bool onDemand = false;
+    // trueの場合はメモリの使用量を抑える（同じ端末でクライアントを多数動かす場合）
+    // ・egl：シェーダープログラムの準備ができたら、シェーダーコンパイラの資源を解放する
+    //   （バックバッファはEGLの実装が確保・解放するため、ここでは数を制御できない）
+    // ・shm：バッファは最大2枚（通常は4枚）。描画が止まったら表示中の1枚だけを残し（シングルバッファ）、
+    //   idleTrimSec秒後に空いたwl_shmの領域の物理メモリを返却する
+    //   --layersでは背景とひし形のバッファは元々1枚ずつなので、返却するのは空いた領域（サイズの変更で作り直す前のもの等）のみ
+    bool lowMemory = false;
+    double idleTrimSec = 5.0;
+
+    // ここからはeglのみ
+    // trueの場合はeglSwapInterval(0)でフレームコールバックを待たずに描画し続ける（スループット計測用）
+    bool uncapped = false;
+    // 0以外の場合、ひし形をこの数だけ格子状に並べて描画する（描画命令の削減効果を計測するためのストレステスト）
+    uint32_t stressCount = 0;
+    // trueの場合はインスタンス描画を使わず、ひし形1つごとに描画命令を発行する（比較用）
+    bool perShapeDraws = false;
+    // trueの場合はEGLコンテキストとサーフェスを描画スレッドに移し、フレームコールバックを専用のイベントキューで処理する
+    bool renderThread = false;
+
+    // ここからはshmのみ
+    // trueの場合、コンポジタが対応していればRGB565のバッファを使う（転送量・合成時の読み込み量が半分になる）
+    bool rgb565 = false;
+    // trueの場合、diamondシーンを背景（親サーフェス）とひし形（サブサーフェス）の2枚のレイヤーに分けて表示する
+    // 背景とひし形は最初のフレームで一度だけ描画し、以降はひし形のレイヤーの位置だけを更新する
+    bool layers = false;
+    // 描画に使うスレッド数（0の場合はCPUのコア数）
+    unsigned threads = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <sys/resource.h>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include "frame_stats.h"
+#include "process_memory.h"
+#include "protocol_stats.h"
+
+// 描画バックエンド（EGL/GLESとwl_shm）を比較するための、1回の実行の要約
+// 両方の描画バックエンドが同じ項目・同じ書式の1行を出力し、bench/backend_suite.shがCSV/JSONにまとめる
+//   [result] backend=egl scene=diamond damage=tracked size=320x320 frames=600 fps=60.000 frame_ms_p50=16.667 ...
+// ・frame_cost_ms   ：1フレームの描画処理（描画の開始からコミットまで。EGLではeglSwapBuffersが戻るまで）の平均
+// ・cpu_ms_per_frame：描画中にプロセス全体（描画スレッドを含む）が使ったCPU時間の、1フレームあたりの値
+// ・rss_kb / pss_kb ：終了時の常駐メモリと、共有ページを共有プロセス数で割って数えた値（process_memory.h）
+// ・requests_per_frame / events_per_frame / wire_bytes_per_frame：1フレームあたりのWaylandの通信量（protocol_stats.h）
+//   --protocol-statsで計測した場合のみ出力する
+struct RunSummary
+{
+    const char *backend = "";
+    std::string scene;
+    bool fullDamage = false;
+    int width = 0, height = 0;
+    // 全フレームの描画処理の時間の合計（ms）
+    double frameCostMs = 0.0;
+    // begin()からのプロセスのCPU時間（ms）
+    double cpuStartMs = 0.0;
+
+    // プロセスのユーザー時間+システム時間（ms）
+    static double processCpuMs()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    }
+
+    // 描画を始める時に呼ぶ（起動処理のCPU時間を含めないため）
+    void begin() { cpuStartMs = processCpuMs(); }
+
+    void print(std::ostream &os, const FrameStats &stats) const
+    {
+        const uint64_t frames = stats.frames();
+        os << std::fixed << std::setprecision(3)
+           << "[result] backend=" << backend
+           << " scene=" << scene
+           << " damage=" << (fullDamage ? "full" : "tracked")
+           << " size=" << width << "x" << height
+           << " frames=" << frames
+           << " fps=" << stats.fps()
+           << " frame_ms_p50=" << stats.percentileMs(0.50)
+           << " frame_ms_p99=" << stats.percentileMs(0.99)
+           << " frame_cost_ms=" << (frames == 0 ? 0.0 : frameCostMs / frames)
+           << " cpu_ms_per_frame=" << (frames == 0 ? 0.0 : (processCpuMs() - cpuStartMs) / frames)
+           << " rss_kb=" << process_memory::residentKb()
+           << " pss_kb=" << process_memory::proportionalKb();
+        if (protocolStats().enabled())
+        {
+            os << " requests_per_frame=" << protocolStats().requestsPerFrame()
+               << " events_per_frame=" << protocolStats().eventsPerFrame()
+               << " wire_bytes_per_frame=" << protocolStats().bytesPerFrame();
+        }
+        os << std::endl;
+    }
+};
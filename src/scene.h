@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include "damage_region.h"
+
+// egl_renderer.h（EGL+OpenGL ES）とshm_renderer.h（wl_shm+ソフトウェアラスタライザ）で共通の描画内容
+// どちらも同じ頂点データからひし形を描画する
+namespace scene
+{
+    // 描画するひし形のサイズを制御するための半径（正規化デバイス座標）
+    constexpr float diamondRadius = 0.5f;
+
+    // 頂点の数（四角形の頂点数）。GL_TRIANGLE_FANとして描画する
+    constexpr int diamondVertexCount = 4;
+
+    // 背景色（薄い灰色）とひし形の色（青）
+    // ARGB8888で、GL側のglClearColor(0.9, 0.9, 0.9) / vec4(0.0, 0.0, 1.0, 1.0)に対応する
+    constexpr uint32_t backgroundColor = 0xffe6e6e6;
+    constexpr uint32_t diamondColor = 0xff0000ff;
+
+    // ひし形の中心のx座標（2秒周期で-0.4〜0.4の範囲を往復）
+    // timeSecは描画開始からの経過時間
+    inline float diamondCenterX(float timeSec)
+    {
+        return 0.4f * std::sin(timeSec * static_cast<float>(M_PI));
+    }
+
+    // width x height の画面に描画した場合に、ひし形が覆うピクセルを含む矩形（左上原点）
+    // 丸め誤差を考慮して1ピクセル分広げ、画面の範囲に切り詰めている
+    inline Rect diamondBounds(float centerX, int width, int height)
+    {
+        const int x0 = static_cast<int>(std::floor((centerX - diamondRadius + 1.0f) * 0.5f * width)) - 1;
+        const int x1 = static_cast<int>(std::ceil((centerX + diamondRadius + 1.0f) * 0.5f * width)) + 1;
+        const int y0 = static_cast<int>(std::floor((1.0f - diamondRadius) * 0.5f * height)) - 1;
+        const int y1 = static_cast<int>(std::ceil((1.0f + diamondRadius) * 0.5f * height)) + 1;
+        return Rect{x0, y0, x1 - x0, y1 - y0}.intersected(Rect{0, 0, width, height});
+    }
+
+    // 頂点データを生成
+    // 各頂点は3次元空間内の座標を持つため（x, y, z）、4つの頂点で12要素の配列に格納する
+    inline void diamondVertices(float centerX, float vertices[diamondVertexCount * 3])
+    {
+        vertices[0] = centerX;       // 上 x座標
+        vertices[1] = diamondRadius; // 上 y座標
+        vertices[2] = 0.0f;          // 上 z座標
+
+        vertices[3] = centerX - diamondRadius; // 左 x座標
+        vertices[4] = 0.0f;                    // 左 y座標
+        vertices[5] = 0.0f;                    // 左 z座標
+
+        vertices[6] = centerX;        // 下 x座標
+        vertices[7] = -diamondRadius; // 下 y座標
+        vertices[8] = 0.0f;           // 下 z座標
+
+        vertices[9] = centerX + diamondRadius; // 右 x座標
+        vertices[10] = 0.0f;                   // 右 y座標
+        vertices[11] = 0.0f;                   // 右 z座標
+    }
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <linux/input-event-codes.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include "presentation_feedback.h"
+
+// wl_seat（入力デバイスの集まり）のポインタとキーボードの入力を受け取る
+//
+// ポインタのイベント（motion/button/axis等）は、wl_pointer.frameが届くまでをまとめて1回の変化として扱う
+// ポインタを素早く動かすとmotionが1フレームの間に何度も届くが、通知（onChange）はframeごとに1回になる
+// 再描画は通知を受けたウィンドウがフレームコールバックに合わせて行うため、入力がいくら多くても
+// フレームコールバック1回につき最大1回しか描画しない
+//
+// 入力を受け取ってから、それを反映したフレームをコミットするまでの時間（input-to-commit）を計測する
+// 最初の未反映の入力を受信した時刻から、ウィンドウがcommitted()を呼ぶまでの時間
+class SeatInput
+{
+public:
+    // frameで確定したポインタの状態（サーフェス座標）
+    struct PointerState
+    {
+        // ポインタが最後に入ったサーフェス（ウィンドウが複数ある場合に、どのウィンドウへの入力かを判断する）
+        wl_surface *surface = nullptr;
+        bool inside = false;
+        double x = 0.0, y = 0.0;
+        // 押されているボタン（1 << (BTN_LEFT等 - BTN_MOUSE)）
+        uint32_t buttons = 0;
+    };
+
+    SeatInput() = default;
+    ~SeatInput() { destroy(); }
+
+    SeatInput(const SeatInput &) = delete;
+    SeatInput &operator=(const SeatInput &) = delete;
+
+    // ポインタの状態が変化した（frameが届いた）、またはキーが押された時に呼ばれる
+    std::function<void()> onChange;
+    // キーが押された時に呼ばれる（keyはevdevのキーコード。KEY_ESC等）
+    // キーによって再描画を要求した場合はtrueを返す。falseの場合（終了や、停止中に描画しないキー）は
+    // コミットに反映される入力ではないため、input-to-commitには数えない
+    std::function<bool(uint32_t key)> onKey;
+
+    // レジストリでwl_seatが見つかったときに呼ぶ
+    // wl_pointer.frameはバージョン5以降のため、対応していれば5でバインドする
+    void bind(wl_registry *registry, uint32_t id, uint32_t version)
+    {
+        if (seat)
+        {
+            // 複数のシートがある場合は最初のものだけを使う
+            return;
+        }
+        seat = static_cast<wl_seat *>(wl_registry_bind(registry, id, &wl_seat_interface, std::min<uint32_t>(version, 5)));
+        wl_seat_add_listener(seat, &seatListener, this);
+    }
+
+    // プロキシを破棄する。wl_display_disconnectより前に呼ぶ必要がある
+    void destroy()
+    {
+        releasePointer();
+        releaseKeyboard();
+        if (seat)
+        {
+            if (wl_seat_get_version(seat) >= WL_SEAT_RELEASE_SINCE_VERSION)
+            {
+                wl_seat_release(seat);
+            }
+            else
+            {
+                wl_seat_destroy(seat);
+            }
+            seat = nullptr;
+        }
+    }
+
+    bool supported() const { return seat != nullptr; }
+
+    const PointerState &pointer() const { return state; }
+
+    // 入力を反映したフレームのコミットの直前に呼ぶ
+    void committed()
+    {
+        committed(takeUnreflected());
+    }
+
+    // 入力の反映を別のスレッド（描画スレッド）で行う場合
+    // ・イベントを処理するスレッドは、onChange/onKeyの中でtakeUnreflected()で受信時刻を取り出し、状態と一緒に渡す
+    // ・反映するスレッドは、そのフレームのコミットの直前にcommitted(受信時刻)を呼ぶ
+    //   （そのスレッドが動いている間は、他のスレッドからcommitted()を呼ばないこと。reportは止めてから呼ぶ）
+    uint64_t takeUnreflected()
+    {
+        const uint64_t receivedNs = unreflectedSinceNs;
+        unreflectedSinceNs = 0;
+        return receivedNs;
+    }
+
+    // receivedNsは0の場合は何もしない
+    void committed(uint64_t receivedNs)
+    {
+        if (receivedNs != 0)
+        {
+            latency.add((now() - receivedNs) / 1e6);
+        }
+    }
+
+    void report(std::ostream &os, const char *label) const
+    {
+        if (!seat)
+        {
+            os << "[" << label << "] seat=none" << std::endl;
+            return;
+        }
+        os << "[" << label << "] pointer_events=" << pointerEvents
+           << " pointer_frames=" << pointerFrames
+           << " key_presses=" << keyPresses
+           << " input_commits=" << latency.count();
+        latency.report(os, "input_to_commit");
+        os << std::endl;
+    }
+
+private:
+    static uint64_t now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    // ポインタのイベントを1つ受け取った。frameまではnextに溜める
+    void pointerEvent()
+    {
+        ++pointerEvents;
+        if (groupStartNs == 0)
+        {
+            groupStartNs = now();
+        }
+        // frameイベントのないバージョンでは、イベントごとに確定する
+        if (wl_pointer_get_version(wlPointer) < WL_POINTER_FRAME_SINCE_VERSION)
+        {
+            flushPointer();
+        }
+    }
+
+    // 溜めたイベントを1つの変化として確定し、通知する
+    void flushPointer()
+    {
+        if (groupStartNs == 0)
+        {
+            return;
+        }
+        ++pointerFrames;
+        state = next;
+        markUnreflected(groupStartNs);
+        groupStartNs = 0;
+        if (onChange)
+        {
+            onChange();
+        }
+    }
+
+    void markUnreflected(uint64_t receivedNs)
+    {
+        if (unreflectedSinceNs == 0)
+        {
+            unreflectedSinceNs = receivedNs;
+        }
+    }
+
+    void releasePointer()
+    {
+        if (!wlPointer)
+        {
+            return;
+        }
+        if (wl_pointer_get_version(wlPointer) >= WL_POINTER_RELEASE_SINCE_VERSION)
+        {
+            wl_pointer_release(wlPointer);
+        }
+        else
+        {
+            wl_pointer_destroy(wlPointer);
+        }
+        wlPointer = nullptr;
+    }
+
+    void releaseKeyboard()
+    {
+        if (!wlKeyboard)
+        {
+            return;
+        }
+        if (wl_keyboard_get_version(wlKeyboard) >= WL_KEYBOARD_RELEASE_SINCE_VERSION)
+        {
+            wl_keyboard_release(wlKeyboard);
+        }
+        else
+        {
+            wl_keyboard_destroy(wlKeyboard);
+        }
+        wlKeyboard = nullptr;
+    }
+
+    // シートが持つデバイスの種類が変わった（最初はバインド直後に届く）
+    static void capabilities(void *data, wl_seat *seat, uint32_t caps)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        const bool hasPointer = caps & WL_SEAT_CAPABILITY_POINTER;
+        if (hasPointer && !self->wlPointer)
+        {
+            self->wlPointer = wl_seat_get_pointer(seat);
+            wl_pointer_add_listener(self->wlPointer, &pointerListener, self);
+        }
+        else if (!hasPointer && self->wlPointer)
+        {
+            self->releasePointer();
+        }
+
+        const bool hasKeyboard = caps & WL_SEAT_CAPABILITY_KEYBOARD;
+        if (hasKeyboard && !self->wlKeyboard)
+        {
+            self->wlKeyboard = wl_seat_get_keyboard(seat);
+            wl_keyboard_add_listener(self->wlKeyboard, &keyboardListener, self);
+        }
+        else if (!hasKeyboard && self->wlKeyboard)
+        {
+            self->releaseKeyboard();
+        }
+    }
+
+    static void seatName(void *, wl_seat *, const char *) {}
+
+    static void pointerEnter(void *data, wl_pointer *, uint32_t, wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        self->next.surface = surface;
+        self->next.inside = true;
+        self->next.x = wl_fixed_to_double(x);
+        self->next.y = wl_fixed_to_double(y);
+        self->pointerEvent();
+    }
+
+    static void pointerLeave(void *data, wl_pointer *, uint32_t, wl_surface *)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        self->next.inside = false;
+        self->next.buttons = 0;
+        self->pointerEvent();
+    }
+
+    static void pointerMotion(void *data, wl_pointer *, uint32_t, wl_fixed_t x, wl_fixed_t y)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        self->next.x = wl_fixed_to_double(x);
+        self->next.y = wl_fixed_to_double(y);
+        self->pointerEvent();
+    }
+
+    static void pointerButton(void *data, wl_pointer *, uint32_t, uint32_t, uint32_t button, uint32_t buttonState)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        if (button >= BTN_MOUSE && button < BTN_MOUSE + 32)
+        {
+            const uint32_t bit = 1u << (button - BTN_MOUSE);
+            if (buttonState == WL_POINTER_BUTTON_STATE_PRESSED)
+            {
+                self->next.buttons |= bit;
+            }
+            else
+            {
+                self->next.buttons &= ~bit;
+            }
+        }
+        self->pointerEvent();
+    }
+
+    // スクロールは使わないが、frameまでのまとまりの一部として数える
+    static void pointerAxis(void *data, wl_pointer *, uint32_t, uint32_t, wl_fixed_t)
+    {
+        static_cast<SeatInput *>(data)->pointerEvent();
+    }
+
+    static void pointerFrame(void *data, wl_pointer *)
+    {
+        static_cast<SeatInput *>(data)->flushPointer();
+    }
+
+    static void pointerAxisSource(void *, wl_pointer *, uint32_t) {}
+    static void pointerAxisStop(void *, wl_pointer *, uint32_t, uint32_t) {}
+    static void pointerAxisDiscrete(void *, wl_pointer *, uint32_t, int32_t) {}
+
+    // キーマップ（xkb）は使わないため、渡されたファイルディスクリプタは閉じるだけ
+    // キーはevdevのキーコードのまま扱う
+    static void keyboardKeymap(void *, wl_keyboard *, uint32_t, int32_t fd, uint32_t)
+    {
+        close(fd);
+    }
+
+    static void keyboardEnter(void *, wl_keyboard *, uint32_t, wl_surface *, wl_array *) {}
+    static void keyboardLeave(void *, wl_keyboard *, uint32_t, wl_surface *) {}
+
+    static void keyboardKey(void *data, wl_keyboard *, uint32_t, uint32_t, uint32_t key, uint32_t keyState)
+    {
+        auto *self = static_cast<SeatInput *>(data);
+        if (keyState != WL_KEYBOARD_KEY_STATE_PRESSED)
+        {
+            return;
+        }
+        ++self->keyPresses;
+        // 待機中はonKeyの中ですぐに描画・コミットされるため、呼ぶ前に受信時刻を記録しておき、
+        // 再描画を要求しなかった場合は取り消す（それより前の未反映の入力があれば、そのまま残す）
+        const bool alreadyUnreflected = self->unreflectedSinceNs != 0;
+        self->markUnreflected(now());
+        const bool redrawScheduled = self->onKey && self->onKey(key);
+        if (!redrawScheduled && !alreadyUnreflected)
+        {
+            self->unreflectedSinceNs = 0;
+        }
+    }
+
+    static void keyboardModifiers(void *, wl_keyboard *, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) {}
+    static void keyboardRepeatInfo(void *, wl_keyboard *, int32_t, int32_t) {}
+
+    static const wl_seat_listener seatListener;
+    static const wl_pointer_listener pointerListener;
+    static const wl_keyboard_listener keyboardListener;
+
+    wl_seat *seat = nullptr;
+    wl_pointer *wlPointer = nullptr;
+    wl_keyboard *wlKeyboard = nullptr;
+
+    // next：frameまでに受け取ったイベントを反映した状態、state：最後のframeで確定した状態
+    PointerState next;
+    PointerState state;
+    // 確定前のまとまりの最初のイベントを受信した時刻（0はまとまりなし）
+    uint64_t groupStartNs = 0;
+    // まだコミットに反映されていない最初の入力を受信した時刻（0は未反映の入力なし）
+    uint64_t unreflectedSinceNs = 0;
+
+    uint64_t pointerEvents = 0;
+    uint64_t pointerFrames = 0;
+    uint64_t keyPresses = 0;
+    LatencyHistogram latency;
+};
+
+inline const wl_seat_listener SeatInput::seatListener = {SeatInput::capabilities, SeatInput::seatName};
+inline const wl_pointer_listener SeatInput::pointerListener = {
+    SeatInput::pointerEnter, SeatInput::pointerLeave, SeatInput::pointerMotion,
+    SeatInput::pointerButton, SeatInput::pointerAxis, SeatInput::pointerFrame,
+    SeatInput::pointerAxisSource, SeatInput::pointerAxisStop, SeatInput::pointerAxisDiscrete};
+inline const wl_keyboard_listener SeatInput::keyboardListener = {
+    SeatInput::keyboardKeymap, SeatInput::keyboardEnter, SeatInput::keyboardLeave,
+    SeatInput::keyboardKey, SeatInput::keyboardModifiers, SeatInput::keyboardRepeatInfo};
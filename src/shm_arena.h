@@ -0,0 +1,239 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+// memfd_createで作成した共有メモリ上に、任意のオフセットでサブ領域を切り出すアリーナ
+// ・ファイルシステムを経由しないため、/tmpがディスク上にある環境でもページキャッシュ以外の書き込みが発生しない
+// ・F_SEAL_SHRINKで縮小を禁止し、コンポジタがマッピング中に領域が切り詰められてSIGBUSになるのを防ぐ
+// ・容量が足りなくなったらftruncate+mremapで同じfdのまま拡張する（wl_shm_pool_resizeで追従できる）
+// ・縮小はできないため、使わなくなった領域の物理メモリはtrim()で返却する（次に書き込んだ時に改めて割り当てられる）
+// Waylandには依存しないため、オフスクリーン描画やベンチマークからも利用できる
+class ShmArena
+{
+public:
+    // サブ領域の先頭アドレスはキャッシュライン境界に揃える
+    static constexpr size_t alignment = 64;
+
+    explicit ShmArena(size_t initialSize, const char *name = "wayland-shm")
+    {
+        fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("memfd_create failed: ") + std::strerror(errno));
+        }
+
+        // 拡張は許可し、縮小のみ禁止する
+        if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) != 0)
+        {
+            close(fd);
+            throw std::runtime_error(std::string("Failed to seal shm arena: ") + std::strerror(errno));
+        }
+
+        capacity = roundUp(initialSize > 0 ? initialSize : alignment, pageSize());
+        if (ftruncate(fd, capacity) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to size shm arena");
+        }
+
+        base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map shm arena");
+        }
+
+        freeBlocks[0] = capacity;
+    }
+
+    ~ShmArena()
+    {
+        munmap(base, capacity);
+        close(fd);
+    }
+
+    ShmArena(const ShmArena &) = delete;
+    ShmArena &operator=(const ShmArena &) = delete;
+
+    // size バイトのサブ領域を確保し、そのオフセットを返す
+    // 空きが足りない場合はアリーナを拡張する（拡張後はベースアドレスが変わる可能性があるため、at()で都度アドレスを引き直すこと）
+    size_t allocate(size_t size)
+    {
+        size = roundUp(size, alignment);
+
+        auto it = findFit(size);
+        if (it == freeBlocks.end())
+        {
+            // 確保のたびに拡張しないよう、容量は倍々で増やす
+            grow(capacity + std::max(capacity, size));
+            it = findFit(size);
+        }
+
+        const size_t offset = it->first;
+        const size_t remaining = it->second - size;
+        freeBlocks.erase(it);
+        if (remaining > 0)
+        {
+            freeBlocks[offset + size] = remaining;
+        }
+        usedBlocks[offset] = size;
+        return offset;
+    }
+
+    // allocate()で確保したサブ領域を返却する。隣接する空き領域とは結合する
+    void release(size_t offset)
+    {
+        auto used = usedBlocks.find(offset);
+        if (used == usedBlocks.end())
+        {
+            throw std::logic_error("ShmArena::release: unknown offset");
+        }
+        size_t size = used->second;
+        usedBlocks.erase(used);
+
+        auto next = freeBlocks.lower_bound(offset);
+        if (next != freeBlocks.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = freeBlocks.erase(next);
+        }
+        if (next != freeBlocks.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += size;
+                return;
+            }
+        }
+        freeBlocks[offset] = size;
+    }
+
+    // 容量を newCapacity バイト以上に拡張する。fdは変わらない
+    void grow(size_t newCapacity)
+    {
+        newCapacity = roundUp(newCapacity, pageSize());
+        if (newCapacity <= capacity)
+        {
+            return;
+        }
+
+        if (ftruncate(fd, newCapacity) != 0)
+        {
+            throw std::runtime_error("Failed to grow shm arena");
+        }
+
+        void *newBase = mremap(base, capacity, newCapacity, MREMAP_MAYMOVE);
+        if (newBase == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to remap shm arena");
+        }
+
+        // 末尾の空き領域と結合する
+        size_t tailOffset = capacity;
+        size_t tailSize = newCapacity - capacity;
+        if (!freeBlocks.empty())
+        {
+            auto last = std::prev(freeBlocks.end());
+            if (last->first + last->second == capacity)
+            {
+                tailOffset = last->first;
+                tailSize += last->second;
+            }
+        }
+        freeBlocks[tailOffset] = tailSize;
+
+        base = newBase;
+        capacity = newCapacity;
+        ++growCount;
+    }
+
+    // 空き領域のページの物理メモリを返却し（FALLOC_FL_PUNCH_HOLE）、対象にしたバイト数を返す（まだ割り当てられていなかったページも含む）
+    // 容量とfd・マッピングはそのままなので、コンポジタ側のwl_shm_poolも変わらない
+    // 空き領域と使用中の領域が同じページにまたがる部分は返却しない
+    size_t trim()
+    {
+        size_t released = 0;
+        for (const auto &block : freeBlocks)
+        {
+            const size_t start = roundUp(block.first, pageSize());
+            const size_t end = (block.first + block.second) / pageSize() * pageSize();
+            if (end > start &&
+                fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(start), static_cast<off_t>(end - start)) == 0)
+            {
+                released += end - start;
+            }
+        }
+        return released;
+    }
+
+    // 使用中のサブ領域の合計（バイト）
+    size_t usedBytes() const
+    {
+        size_t used = 0;
+        for (const auto &block : usedBlocks)
+        {
+            used += block.second;
+        }
+        return used;
+    }
+
+    // 大きさが変わるサブ領域（ウィンドウのサイズに合わせるバッファ等）を、required バイトに合わせて確保し直す時の容量
+    // 今の容量に収まる場合はそのまま使い回し、収まらない場合は今の1.5倍以上にする
+    // （少しずつ大きくなる場合でも、確保し直す回数はサイズの対数程度で済む）
+    static size_t grownCapacity(size_t capacity, size_t required)
+    {
+        return required <= capacity ? capacity : std::max(required, capacity + capacity / 2);
+    }
+
+    template <typename T = uint8_t>
+    T *at(size_t offset) const { return reinterpret_cast<T *>(static_cast<uint8_t *>(base) + offset); }
+
+    int getFd() const { return fd; }
+    size_t getCapacity() const { return capacity; }
+    uint64_t getGrowCount() const { return growCount; }
+
+private:
+    static size_t pageSize()
+    {
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    static size_t roundUp(size_t value, size_t align)
+    {
+        return (value + align - 1) / align * align;
+    }
+
+    // 先頭から探して最初に収まる空き領域（first-fit）
+    std::map<size_t, size_t>::iterator findFit(size_t size)
+    {
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            if (it->second >= size)
+            {
+                return it;
+            }
+        }
+        return freeBlocks.end();
+    }
+
+    int fd = -1;
+    void *base = nullptr;
+    size_t capacity = 0;
+    uint64_t growCount = 0;
+    // オフセット → サイズ
+    std::map<size_t, size_t> freeBlocks;
+    std::map<size_t, size_t> usedBlocks;
+};
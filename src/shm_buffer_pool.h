@@ -0,0 +1,264 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "shm_arena.h"
+
+// ShmArenaとそれに対応するwl_shm_poolの組
+// 1つのfd・1つのマッピングを複数のウィンドウ（ShmBufferPool）で共有し、
+// アリーナが拡張された場合はwl_shm_pool_resizeでコンポジタ側のマッピングも追従させる
+class SharedShmPool
+{
+public:
+    SharedShmPool(wl_shm *shm, size_t initialSize) : arena(initialSize)
+    {
+        pool = wl_shm_create_pool(shm, arena.getFd(), static_cast<int32_t>(arena.getCapacity()));
+    }
+
+    ~SharedShmPool()
+    {
+        wl_shm_pool_destroy(pool);
+    }
+
+    SharedShmPool(const SharedShmPool &) = delete;
+    SharedShmPool &operator=(const SharedShmPool &) = delete;
+
+    size_t allocate(size_t size)
+    {
+        const size_t offset = arena.allocate(size);
+        if (arena.getCapacity() != poolSize)
+        {
+            // wl_shm_pool_resizeは拡張のみ可能。アリーナもF_SEAL_SHRINKで縮小しない
+            wl_shm_pool_resize(pool, static_cast<int32_t>(arena.getCapacity()));
+            poolSize = arena.getCapacity();
+        }
+        return offset;
+    }
+
+    void release(size_t offset) { arena.release(offset); }
+
+    // 空き領域の物理メモリを返却する（ShmArena::trim）
+    size_t trim() { return arena.trim(); }
+
+    wl_buffer *createBuffer(size_t offset, int width, int height, int stride, uint32_t format)
+    {
+        return wl_shm_pool_create_buffer(pool, static_cast<int32_t>(offset), width, height, stride, format);
+    }
+
+    ShmArena &getArena() { return arena; }
+
+private:
+    ShmArena arena;
+    wl_shm_pool *pool = nullptr;
+    size_t poolSize = arena.getCapacity();
+};
+
+// wl_shmのバッファを使い回すためのプール
+// バッファは共有アリーナ上に一度だけ確保し、以降はコンポジタからのwl_buffer.releaseを見て空いているものを再利用する
+// 全てのバッファがコンポジタに使用中の場合のみ、新しいバッファを追加してプールを拡張する
+// サイズの変更（resize）ではバッファを作り直さず、確保済みの領域を使い回す
+// 描画が止まっている間はshrink()でバッファを減らせる（次に必要になった時にacquire()で確保し直す）
+class ShmBufferPool
+{
+public:
+    struct Buffer
+    {
+        ShmBufferPool *owner = nullptr;
+        wl_buffer *wlBuffer = nullptr;
+        // 共有アリーナ内でのオフセットと、確保済みの領域の大きさ（サイズ変更後は使用中の大きさより大きいことがある）
+        size_t offset = 0;
+        size_t capacity = 0;
+        // wlBufferのサイズ。プールのサイズが変わった後は、次にacquire()された時に合わせる
+        int width = 0, height = 0;
+        // コンポジタにアタッチ中で、まだreleaseされていない状態
+        bool busy = false;
+        // 最後に描画したフレームの番号（0は未描画）。バッファエイジの計算に使う
+        uint64_t paintedFrame = 0;
+
+        // アリーナの拡張でベースアドレスが変わることがあるため、ポインタは保持せず都度計算する
+        // Tはピクセルの型（RGB565ならuint16_t）
+        template <typename T = uint32_t>
+        T *data() const { return owner->shared->getArena().at<T>(offset); }
+    };
+
+    // formatの1ピクセルあたりのバイト数（このプールが扱うのは32bitとRGB565のみ）
+    static int bytesPerPixel(uint32_t format)
+    {
+        return format == WL_SHM_FORMAT_RGB565 ? 2 : 4;
+    }
+
+    // initialCount個のバッファを事前に確保する。拡張はmaxCount個まで
+    // sharedを渡すと、他のウィンドウと同じアリーナ（fd・マッピング）からバッファを切り出す
+    ShmBufferPool(wl_shm *shm, int width, int height, uint32_t format, int initialCount = 2, int maxCount = 4,
+                  std::shared_ptr<SharedShmPool> shared = nullptr)
+        : shared(shared), width(width), height(height), stride(width * bytesPerPixel(format)), format(format), maxCount(maxCount)
+    {
+        if (!this->shared)
+        {
+            this->shared = std::make_shared<SharedShmPool>(shm, static_cast<size_t>(stride) * height * initialCount);
+        }
+
+        buffers.reserve(maxCount);
+        for (int i = 0; i < initialCount; ++i)
+        {
+            addBuffer();
+        }
+    }
+
+    ~ShmBufferPool()
+    {
+        for (auto &buffer : buffers)
+        {
+            wl_buffer_destroy(buffer->wlBuffer);
+            shared->release(buffer->offset);
+        }
+    }
+
+    ShmBufferPool(const ShmBufferPool &) = delete;
+    ShmBufferPool &operator=(const ShmBufferPool &) = delete;
+
+    // 空いているバッファを取得し、使用中としてマークする
+    // 空きがなく、これ以上拡張もできない場合はnullptrを返す（呼び出し側はそのフレームの描画を見送る）
+    Buffer *acquire()
+    {
+        for (auto &buffer : buffers)
+        {
+            if (!buffer->busy)
+            {
+                if (buffer->width != width || buffer->height != height)
+                {
+                    reshape(*buffer);
+                }
+                buffer->busy = true;
+                return buffer.get();
+            }
+        }
+
+        if (static_cast<int>(buffers.size()) >= maxCount)
+        {
+            return nullptr;
+        }
+
+        Buffer *buffer = addBuffer();
+        buffer->busy = true;
+        return buffer;
+    }
+
+    // 空いているバッファを破棄して、keep個まで減らす。返却した領域のバイト数を返す
+    // 最後に描画したバッファ（表示中の内容）と、コンポジタが使用中のバッファは残す
+    size_t shrink(size_t keep)
+    {
+        uint64_t newest = 0;
+        for (const auto &buffer : buffers)
+        {
+            newest = std::max(newest, buffer->paintedFrame);
+        }
+
+        size_t released = 0;
+        for (auto it = buffers.begin(); it != buffers.end() && buffers.size() > keep;)
+        {
+            Buffer &buffer = **it;
+            if (buffer.busy || (newest != 0 && buffer.paintedFrame == newest))
+            {
+                ++it;
+                continue;
+            }
+            wl_buffer_destroy(buffer.wlBuffer);
+            shared->release(buffer.offset);
+            released += buffer.capacity;
+            it = buffers.erase(it);
+        }
+        return released;
+    }
+
+    // バッファのサイズを変更する
+    // 各バッファはコンポジタから返却されている（次にacquire()される）時に新しいサイズにする
+    // ・確保済みの領域に収まる場合：同じ領域にwl_bufferを作り直すだけで、メモリの確保は行わない
+    // ・収まらない場合：領域を返却し、ShmArena::grownCapacity（今の1.5倍以上）で確保し直す
+    void resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        stride = width * bytesPerPixel(format);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getStride() const { return stride; }
+    uint32_t getFormat() const { return format; }
+    size_t bufferCount() const { return buffers.size(); }
+    // これまでに同時に存在したバッファの最大数
+    size_t peakBufferCount() const { return peakCount; }
+    const std::shared_ptr<SharedShmPool> &getShared() const { return shared; }
+
+    // これまでにプールが行ったバッファ確保（アリーナからの切り出し）の回数
+    uint64_t allocationCount() const { return allocations; }
+    // サイズの変更で、確保済みの領域をそのまま使い回した回数
+    uint64_t reuseCount() const { return reuses; }
+
+private:
+    // wl_buffer.release: コンポジタがバッファの内容を読み終え、クライアントが再利用してよくなったことを示す
+    static void bufferRelease(void *data, wl_buffer *wlBuffer)
+    {
+        static_cast<Buffer *>(data)->busy = false;
+    }
+
+    static const wl_buffer_listener bufferListener;
+
+    Buffer *addBuffer()
+    {
+        auto buffer = std::unique_ptr<Buffer>(new Buffer);
+        buffer->owner = this;
+        buffer->capacity = static_cast<size_t>(stride) * height;
+        buffer->offset = shared->allocate(buffer->capacity);
+        ++allocations;
+        createWlBuffer(*buffer);
+
+        buffers.push_back(std::move(buffer));
+        peakCount = std::max(peakCount, buffers.size());
+        return buffers.back().get();
+    }
+
+    // 返却済みのバッファを今のサイズにする（resizeを参照）
+    void reshape(Buffer &buffer)
+    {
+        wl_buffer_destroy(buffer.wlBuffer);
+        const size_t size = static_cast<size_t>(stride) * height;
+        if (size <= buffer.capacity)
+        {
+            ++reuses;
+        }
+        else
+        {
+            shared->release(buffer.offset);
+            buffer.capacity = ShmArena::grownCapacity(buffer.capacity, size);
+            buffer.offset = shared->allocate(buffer.capacity);
+            ++allocations;
+        }
+        // 内容はサイズが変わったので使えない（バッファエイジは0になる）
+        buffer.paintedFrame = 0;
+        createWlBuffer(buffer);
+    }
+
+    void createWlBuffer(Buffer &buffer)
+    {
+        buffer.width = width;
+        buffer.height = height;
+        buffer.wlBuffer = shared->createBuffer(buffer.offset, width, height, stride, format);
+        wl_buffer_add_listener(buffer.wlBuffer, &bufferListener, &buffer);
+    }
+
+    std::shared_ptr<SharedShmPool> shared;
+    int width, height, stride;
+    uint32_t format;
+    int maxCount;
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+    size_t peakCount = 0;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+inline const wl_buffer_listener ShmBufferPool::bufferListener = {ShmBufferPool::bufferRelease};
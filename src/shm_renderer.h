@@ -0,0 +1,627 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "damage_region.h"
+#include "frame_stats.h"
+#include "pixel_kernels.h"
+#include "ppm_image.h"
+#include "renderer.h"
+#include "run_options.h"
+#include "scene.h"
+#include "shm_buffer_pool.h"
+#include "soft_rasterizer.h"
+#include "startup_trace.h"
+#include "subsurface_layer.h"
+#include "thread_pool.h"
+#include "tile_renderer.h"
+
+class ShmRenderTarget;
+
+// wl_shmの描画バックエンド（--backend shm）
+// EGLを使わず、共有メモリのバッファにCPUで描画する
+// 描画に使うスレッドプールとソフトウェアラスタライザ、バッファを切り出すアリーナ（memfd）をすべてのウィンドウで共有する
+class ShmRenderer : public Renderer
+{
+public:
+    explicit ShmRenderer(const RunOptions &runOptions)
+        : options(runOptions), threadPool(runOptions.threads), tileRenderer(threadPool)
+    {
+    }
+
+    const char *name() const override { return "shm"; }
+    std::string sceneName() const override { return options.scene == Scene::Pattern ? "pattern" : "diamond"; }
+    // バッファのフォーマットを選ぶため、wl_shmの対応フォーマットの一覧まで待つ
+    bool needsShmFormats() const override { return true; }
+
+    std::unique_ptr<RenderTarget> createTarget(WaylandConnection::Globals &globals, wl_surface *surface,
+                                               int width, int height) override;
+
+    void report(std::ostream &os, uint64_t) const override
+    {
+        os << "[shm] pixel_kernels=" << pixelKernels().name
+           << " threads=" << threadPool.size()
+           << " tiles=" << tileRenderer.tileCount() << std::endl;
+    }
+
+    // shm_mapped_kbはアリーナ（memfd）の大きさ、shm_used_kbはそのうちバッファが使っている分
+    void reportMemory(std::ostream &os) const override;
+
+    void runOffscreen(int width, int height) override
+    {
+        // コンポジタに接続せず、メモリ上の画像（XRGB8888）に描画する
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height, 0);
+        const uint64_t frames = options.maxFrames != 0 ? options.maxFrames : 600;
+        FrameStats stats;
+        DamageRegion frameDamage;
+        Rect lastDiamondBounds;
+        uint64_t repaintedPixels = 0;
+        double renderSec = 0.0;
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            const auto start = FrameStats::Clock::now();
+            const float centerX = scene::diamondCenterX(static_cast<float>(i) / 60.0f);
+            // 描画先は1枚の画像を使い回すため、前のフレームから変化した領域だけを描けばよい
+            sceneDamage(centerX, width, height, i == 0, lastDiamondBounds, frameDamage);
+            drawScene(pixels.data(), width * 4, width, height, frameDamage, static_cast<uint32_t>(i), centerX);
+            renderSec += std::chrono::duration<double>(FrameStats::Clock::now() - start).count();
+            repaintedPixels += frameDamage.area();
+            stats.frame();
+
+            if (!options.dumpDir.empty())
+            {
+                const std::string path = ppm_image::framePath(options.dumpDir, "shm", i + 1);
+                if (!ppm_image::writeXrgb(path, pixels.data(), width, height, width))
+                {
+                    throw std::runtime_error("Failed to write " + path);
+                }
+            }
+        }
+
+        stats.report(std::cout, "shm offscreen");
+        std::cout << "[shm offscreen] frames=" << frames
+                  << " render_fps=" << (renderSec > 0.0 ? frames / renderSec : 0.0)
+                  << " pixel_kernels=" << pixelKernels().name
+                  << " threads=" << threadPool.size()
+                  << " repainted=" << static_cast<double>(repaintedPixels) / (static_cast<double>(width) * height * frames) * 100.0
+                  << "%" << std::endl;
+    }
+
+    const RunOptions &runOptions() const { return options; }
+    SoftRasterizer &softRasterizer() { return rasterizer; }
+    TileRenderer &tiles() { return tileRenderer; }
+
+    // バッファのregionに含まれる部分に、width x heightの画面の描画内容を書き込む
+    // frameはアニメーション用のフレーム番号（0から）、centerXはひし形の中心のx座標
+    void drawScene(uint32_t *data, int stride, int width, int height, const DamageRegion &region, uint32_t frame, float centerX)
+    {
+        const PixelKernels &kernels = pixelKernels();
+        const int pitch = stride / 4;
+
+        // 描き直す領域をタイルに分割してスレッドプールで並列に描画し、全タイルの完了を待ってから戻る
+        // 実際の書き込みはCPUに合わせて選択されたSIMDカーネル（pixel_kernels.h）が行う
+        if (options.scene == Scene::Pattern)
+        {
+            // ABGR形式で各ピクセルに色を指定（パターンを斜めにスクロールさせる）
+            tileRenderer.render(width, height, region, [&](const Tile &tile) {
+                kernels.pattern(data, pitch, tile.x, tile.y, tile.w, tile.h, frame);
+            });
+            return;
+        }
+
+        // EGLのバックエンドと同じ頂点データを、GL_TRIANGLE_FAN相当としてソフトウェアラスタライザで描画する
+        float vertices[scene::diamondVertexCount * 3];
+        scene::diamondVertices(centerX, vertices);
+
+        rasterizer.setTarget(data, pitch, width, height);
+        tileRenderer.render(width, height, region, [&](const Tile &tile) {
+            // glClear相当の背景塗りつぶしも、タイル単位で行う
+            kernels.fillRect(data, pitch, tile.x, tile.y, tile.w, tile.h, scene::backgroundColor);
+            rasterizer.drawTriangleFan(vertices, scene::diamondVertexCount, scene::diamondColor, tile);
+        });
+    }
+
+    // 今回のフレームで変化する領域をdamageに求める（width x heightの画面。fullの場合は全体）
+    // lastBoundsは前のフレームのひし形を含む矩形で、今回のものに更新する
+    void sceneDamage(float centerX, int width, int height, bool full, Rect &lastBounds, DamageRegion &damage) const
+    {
+        const Rect bounds = scene::diamondBounds(centerX, width, height);
+        damage.clear();
+        if (options.scene == Scene::Pattern || options.fullDamage || full)
+        {
+            // パターンは毎フレーム全体が変化する
+            damage.add(Rect{0, 0, width, height});
+        }
+        else
+        {
+            // 移動前と移動後のひし形を含む矩形
+            damage.add(lastBounds);
+            damage.add(bounds);
+        }
+        lastBounds = bounds;
+    }
+
+    // 描画が止まっている間のメモリの返却の記録（--low-memory）
+    void idleShrunk(size_t bytes)
+    {
+        shrunkBytes += bytes;
+        ++idleShrinks;
+    }
+    void idleTrimmed(size_t bytes)
+    {
+        trimmedBytes += bytes;
+        ++idleTrims;
+    }
+
+    // 描画先の登録（メモリの使用量の集計用）。描画先の破棄時に外す
+    void removeTarget(const ShmRenderTarget *target)
+    {
+        targets.erase(std::remove(targets.begin(), targets.end(), target), targets.end());
+    }
+
+private:
+    RunOptions options;
+    ThreadPool threadPool;
+    TileRenderer tileRenderer;
+    // 描画は1つのスレッドから順に呼ばれるため、ラスタライザは全ウィンドウで使い回す
+    SoftRasterizer rasterizer;
+    // 全ウィンドウのバッファを切り出すアリーナ（最初のウィンドウのバッファプールが作る）
+    std::shared_ptr<SharedShmPool> arena;
+    std::vector<const ShmRenderTarget *> targets;
+
+    uint64_t idleShrinks = 0;
+    uint64_t idleTrims = 0;
+    size_t shrunkBytes = 0;
+    size_t trimmedBytes = 0;
+};
+
+// wl_shmの描画先：1枚のウィンドウのバッファプール（--layersの場合はひし形のサブサーフェスも）と、そのダメージトラッキングの状態
+class ShmRenderTarget : public RenderTarget
+{
+public:
+    // sharedはバッファを切り出すアリーナ（nullptrの場合は新しく作る）
+    ShmRenderTarget(ShmRenderer &renderer, WaylandConnection::Globals &globals, wl_surface *surface, int width, int height,
+                    std::shared_ptr<SharedShmPool> shared)
+        : renderer(renderer), options(renderer.runOptions()), globals(globals), wlSurface(surface),
+          width(width), height(height), renderWidth(width), renderHeight(height)
+    {
+        // バッファプールはここで一度だけ作成し、以降のフレームでは使い回す
+        const uint32_t format = chooseFormat();
+        if (useLayers())
+        {
+            // 親サーフェスのバッファは背景だけを描いて一度アタッチするため、1つで足りる
+            bufferPool.reset(new ShmBufferPool(globals.shm, width, height, format, 1, 1, shared));
+            initDiamondLayer();
+            return;
+        }
+        if (options.lowMemory)
+        {
+            bufferPool.reset(new ShmBufferPool(globals.shm, width, height, format, 1, 2, shared));
+        }
+        else
+        {
+            bufferPool.reset(new ShmBufferPool(globals.shm, width, height, format, 2, 4, shared));
+        }
+        if (format == WL_SHM_FORMAT_RGB565)
+        {
+            // 描画は32bitで行い、変化した部分だけをRGB565に変換してバッファに書き込む
+            staging.assign(static_cast<size_t>(width) * height, 0);
+        }
+    }
+
+    // バッファはサーフェスより先に破棄する
+    // サブサーフェスは親サーフェスより先に破棄する
+    ~ShmRenderTarget() override
+    {
+        renderer.removeTarget(this);
+        diamondLayer.reset();
+        bufferPool.reset();
+    }
+
+    ShmRenderTarget(const ShmRenderTarget &) = delete;
+    ShmRenderTarget &operator=(const ShmRenderTarget &) = delete;
+
+    const ShmBufferPool &pool() const { return *bufferPool; }
+    const std::shared_ptr<SharedShmPool> &shared() const { return bufferPool->getShared(); }
+    bool layered() const { return diamondLayer != nullptr; }
+
+    // 表示中のバッファの数（--layersではひし形のレイヤーの分も含む）
+    size_t liveBuffers() const
+    {
+        return bufferPool->bufferCount() + (diamondLayer ? diamondLayer->pool().bufferCount() : 0);
+    }
+    size_t peakBuffers() const
+    {
+        return bufferPool->peakBufferCount() + (diamondLayer ? diamondLayer->pool().peakBufferCount() : 0);
+    }
+
+    bool draw(const Frame &frame) override
+    {
+        if (diamondLayer)
+        {
+            drawLayers(frame);
+            return true;
+        }
+
+        // コンポジタがまだ読み取っていない（releaseされていない）バッファには書き込めないため、空いているものを取得
+        ShmBufferPool::Buffer *buffer = bufferPool->acquire();
+        if (!buffer)
+        {
+            ++skippedFrames;
+            return false;
+        }
+
+        updateDamage(frame);
+
+        // バッファエイジ：このバッファに最後に描画したのが何フレーム前か（0は未描画）
+        const uint64_t age = buffer->paintedFrame == 0 ? 0 : frame.number - buffer->paintedFrame;
+        if (options.fullDamage || !damageHistory.repaintRegion(age, repaintRegion))
+        {
+            repaintRegion.clear();
+            repaintRegion.add(Rect{0, 0, renderWidth, renderHeight});
+        }
+
+        paint(*buffer, frame);
+        buffer->paintedFrame = frame.number;
+        repaintedPixels += repaintRegion.area();
+        damagedPixels += frameDamage.area();
+        renderedAreaPixels += static_cast<uint64_t>(renderWidth) * renderHeight;
+
+        // 作成済みのバッファをWaylandサーフェスにアタッチ
+        // これにより、バッファの内容がサーフェスに表示される
+        // オフセットを(0, 0)に指定することで、サーフェスの左上隅にバッファを配置
+        wl_surface_attach(wlSurface, buffer->wlBuffer, 0, 0);
+
+        // サーフェスのどの部分が更新されたかをWaylandコンポジタに通知
+        // 前回のコミットから変化した領域のみを伝えることで、コンポジタ側の合成処理も減らせる
+        // damage_bufferはバッファ座標で指定する（スケールや回転、wp_viewportによる拡大の影響を受けない）
+        // damage_bufferが使えず、バッファを拡大して表示している場合は、サーフェス全体を通知する
+        if (!useDamageBuffer() && (renderWidth != width || renderHeight != height))
+        {
+            wl_surface_damage(wlSurface, 0, 0, width, height);
+        }
+        else
+        {
+            for (const Rect &rect : frameDamage)
+            {
+                if (useDamageBuffer())
+                {
+                    wl_surface_damage_buffer(wlSurface, rect.x, rect.y, rect.w, rect.h);
+                }
+                else
+                {
+                    wl_surface_damage(wlSurface, rect.x, rect.y, rect.w, rect.h);
+                }
+            }
+        }
+        return true;
+    }
+
+    // サーフェスへの変更（バッファのアタッチやダメージの通知、フレームコールバック）をコミットし、
+    // Waylandコンポジタにこれらの変更を表示するよう指示
+    // 送信はイベントループのwl_display_dispatch内でフラッシュされる
+    void present() override
+    {
+        wl_surface_commit(wlSurface);
+    }
+
+    // バッファプールは作り直さずにサイズだけを変え、確保済みの領域を使い回す
+    // バッファはコンポジタから返却された後、次に使う時に新しいサイズにする
+    void resize(int newWidth, int newHeight, int newRenderWidth, int newRenderHeight) override
+    {
+        width = newWidth;
+        height = newHeight;
+        renderWidth = newRenderWidth;
+        renderHeight = newRenderHeight;
+        if (diamondLayer)
+        {
+            // ひし形の大きさも変わるため、レイヤーは作り直す（アリーナは共有のまま）
+            // レイヤー表示では動的解像度を使わないため、描画サイズは表示サイズと同じ
+            bufferPool->resize(width, height);
+            diamondLayer.reset();
+            initDiamondLayer();
+            backgroundDirty = true;
+            return;
+        }
+        bufferPool->resize(renderWidth, renderHeight);
+        if (!staging.empty())
+        {
+            staging.assign(static_cast<size_t>(renderWidth) * renderHeight, 0);
+        }
+    }
+
+    // 背景を描き直せなかった間は、新しいサイズの内容はまだコミットされていない（--layers）
+    bool sizeCommitted() const override { return !backgroundDirty; }
+
+    // レイヤー表示では毎フレームの描画がないため、動的解像度は使わない
+    bool scalable() const override { return !diamondLayer; }
+
+    // ひし形のレイヤーの上では、レイヤーの位置を親サーフェスの座標に直す
+    bool subsurfaceOffset(wl_surface *surface, double &offsetX) const override
+    {
+        if (!diamondLayer || surface != diamondLayer->surface())
+        {
+            return false;
+        }
+        offsetX = diamondLayer->getX();
+        return true;
+    }
+
+    // 描画を止めて入力を待ち始めた（--low-memory）
+    // 表示中のバッファ以外を破棄してシングルバッファにする
+    // 再び描画する時は、足りないバッファをacquire()で確保し直す
+    // --layersではひし形のレイヤーのプールも同じように減らす（どちらも同じアリーナから切り出している）
+    void idle() override
+    {
+        size_t bytes = bufferPool->shrink(1);
+        if (diamondLayer)
+        {
+            bytes += diamondLayer->pool().shrink(1);
+        }
+        renderer.idleShrunk(bytes);
+    }
+
+    // 破棄して空いた領域の物理メモリを返却する（アリーナの大きさは変えない。返却したページには書き込んだ時に改めて割り当てられる）
+    void trim() override
+    {
+        renderer.idleTrimmed(bufferPool->getShared()->trim());
+    }
+
+    void report(std::ostream &os) const override
+    {
+        os << "[shm] buffers=" << bufferPool->bufferCount()
+           << " allocations=" << bufferPool->allocationCount()
+           << " resize_reuses=" << bufferPool->reuseCount()
+           << " arena_grows=" << bufferPool->getShared()->getArena().getGrowCount()
+           << " skipped_frames=" << skippedFrames << std::endl;
+        os << "[shm] format=" << formatName(bufferPool->getFormat())
+           << " opaque_region=" << (options.translucent ? "no" : "yes")
+           << " layers=" << (diamondLayer ? 2 : 1) << std::endl;
+        os << "[shm] damage_buffer=" << (useDamageBuffer() ? "yes" : "no")
+           << " repainted=" << ratioOfSurface(repaintedPixels) * 100.0 << "%"
+           << " damaged=" << ratioOfSurface(damagedPixels) * 100.0 << "%" << std::endl;
+    }
+
+private:
+    ShmRenderer &renderer;
+    const RunOptions &options;
+    WaylandConnection::Globals &globals;
+    wl_surface *wlSurface;
+    // 表示サイズ（サーフェス座標）と、実際に描画するバッファのサイズ
+    // 動的解像度が無効な場合は同じ
+    int width, height;
+    int renderWidth, renderHeight;
+
+    // ウィンドウや描画サイズが変わっても作り直さず、resizeで確保済みの領域を使い回す
+    std::unique_ptr<ShmBufferPool> bufferPool;
+    // RGB565の場合の描画先（XRGB8888、常に直前のフレームの内容を保持する）
+    std::vector<uint32_t> staging;
+    // --layersの場合のひし形のレイヤーと、centerX = 0の時のその位置
+    std::unique_ptr<SubsurfaceLayer> diamondLayer;
+    Rect diamondOrigin;
+    // ウィンドウのサイズが変わり、背景を描き直す必要がある（--layers）
+    bool backgroundDirty = false;
+    uint64_t skippedFrames = 0;
+
+    // ダメージトラッキング
+    // 各バッファが最後に描画されたフレーム番号からバッファエイジを求め、それ以降に変化した領域だけを描き直す
+    DamageHistory damageHistory;
+    DamageRegion frameDamage;
+    DamageRegion repaintRegion;
+    Rect lastDiamondBounds;
+    uint64_t repaintedPixels = 0;
+    uint64_t damagedPixels = 0;
+    // 各フレームの描画サイズの面積の合計（描き直した割合の分母）
+    uint64_t renderedAreaPixels = 0;
+
+    // バッファのピクセルフォーマットを決める
+    // 内容は常に不透明なので、アルファを持たないフォーマットを選ぶ
+    // （コンポジタはアルファを読まずに済み、不透明領域と合わせてブレンドを省略できる）
+    uint32_t chooseFormat() const
+    {
+        if (options.translucent)
+        {
+            return WL_SHM_FORMAT_ARGB8888;
+        }
+        if (options.rgb565)
+        {
+            if (globals.rgb565)
+            {
+                return WL_SHM_FORMAT_RGB565;
+            }
+            std::cout << "[shm] RGB565 is not supported by the compositor, using XRGB8888" << std::endl;
+        }
+        return globals.xrgb8888 ? WL_SHM_FORMAT_XRGB8888 : WL_SHM_FORMAT_ARGB8888;
+    }
+
+    static const char *formatName(uint32_t format)
+    {
+        switch (format)
+        {
+        case WL_SHM_FORMAT_XRGB8888:
+            return "xrgb8888";
+        case WL_SHM_FORMAT_RGB565:
+            return "rgb565";
+        default:
+            return "argb8888";
+        }
+    }
+
+    bool useLayers() const
+    {
+        return options.layers && options.scene == Scene::Diamond && globals.subcompositor;
+    }
+
+    // ひし形のレイヤーを作成し、centerX = 0の位置のひし形を一度だけ描画する
+    // ひし形の外側は透明にする必要があるため、このレイヤーはアルファ付き（ARGB8888、アルファ済み）
+    void initDiamondLayer()
+    {
+        diamondOrigin = scene::diamondBounds(0.0f, width, height);
+        diamondLayer.reset(new SubsurfaceLayer(globals.compositor, globals.subcompositor, wlSurface, globals.shm,
+                                               diamondOrigin.w, diamondOrigin.h, WL_SHM_FORMAT_ARGB8888, 1,
+                                               bufferPool->getShared()));
+        // 位置の変更を親のコミットと同時に反映させるため、同期モードにする
+        diamondLayer->setSynchronized(true);
+
+        // ラスタライザは画面全体の座標で描画するため、一時的な画面サイズの画像に描いてからレイヤーのバッファに切り出す
+        std::vector<uint32_t> image(static_cast<size_t>(width) * height, 0);
+        float vertices[scene::diamondVertexCount * 3];
+        scene::diamondVertices(0.0f, vertices);
+        SoftRasterizer &rasterizer = renderer.softRasterizer();
+        rasterizer.setTarget(image.data(), width, width, height);
+        rasterizer.drawTriangleFan(vertices, scene::diamondVertexCount, scene::diamondColor,
+                                   Tile{diamondOrigin.x, diamondOrigin.y, diamondOrigin.w, diamondOrigin.h});
+
+        ShmBufferPool::Buffer *buffer = diamondLayer->pool().acquire();
+        const int pitch = diamondLayer->pool().getStride() / 4;
+        for (int y = 0; y < diamondOrigin.h; ++y)
+        {
+            std::copy_n(image.data() + static_cast<size_t>(diamondOrigin.y + y) * width + diamondOrigin.x, diamondOrigin.w,
+                        buffer->data() + static_cast<size_t>(y) * pitch);
+        }
+        // 同期モードのため、このコミットは親サーフェスの最初のコミットで反映される
+        wl_surface_attach(diamondLayer->surface(), buffer->wlBuffer, 0, 0);
+        wl_surface_damage(diamondLayer->surface(), 0, 0, diamondOrigin.w, diamondOrigin.h);
+        wl_surface_commit(diamondLayer->surface());
+        repaintedPixels += diamondOrigin.area();
+    }
+
+    // --layersの場合の1フレーム分の更新
+    // 背景とひし形の内容は変わらないため、最初のフレーム以外は描画を行わず、ひし形のレイヤーの位置だけを変える
+    // （合成し直す範囲は、コンポジタがレイヤーの移動前と移動後の位置から求める）
+    void drawLayers(const Frame &frame)
+    {
+        updateDamage(frame);
+        damagedPixels += frameDamage.area();
+        renderedAreaPixels += static_cast<uint64_t>(width) * height;
+
+        if (frame.number == 1 || backgroundDirty)
+        {
+            attachBackground();
+        }
+
+        // ひし形の移動量をピクセル単位に丸めて位置に反映する
+        diamondLayer->setPosition(diamondOrigin.x + static_cast<int>(std::lround(frame.centerX * 0.5f * width)), diamondOrigin.y);
+    }
+
+    // 背景を描いたバッファを親サーフェスにアタッチする（--layers）
+    // バッファは1つだけなので、コンポジタがまだ前の背景を使っている間は見送り、次のフレームでやり直す
+    void attachBackground()
+    {
+        ShmBufferPool::Buffer *buffer = bufferPool->acquire();
+        if (!buffer)
+        {
+            backgroundDirty = true;
+            return;
+        }
+        fillBackground(*buffer);
+        repaintedPixels += static_cast<uint64_t>(width) * height;
+        wl_surface_attach(wlSurface, buffer->wlBuffer, 0, 0);
+        wl_surface_damage(wlSurface, 0, 0, width, height);
+        backgroundDirty = false;
+    }
+
+    // 背景色で塗りつぶす（背景のレイヤー用）
+    void fillBackground(const ShmBufferPool::Buffer &buffer)
+    {
+        if (bufferPool->getFormat() == WL_SHM_FORMAT_RGB565)
+        {
+            std::fill_n(buffer.data<uint16_t>(), static_cast<size_t>(bufferPool->getStride() / 2) * height,
+                        pixel_kernels::rgb565Pixel(scene::backgroundColor));
+            return;
+        }
+        pixelKernels().fill(buffer.data(), static_cast<size_t>(bufferPool->getStride() / 4) * height, scene::backgroundColor);
+    }
+
+    // バッファのrepaintRegionの部分を今回のフレームの内容にする
+    void paint(const ShmBufferPool::Buffer &buffer, const Frame &frame)
+    {
+        const uint32_t number = static_cast<uint32_t>(frame.number - 1);
+        if (staging.empty())
+        {
+            renderer.drawScene(buffer.data(), bufferPool->getStride(), renderWidth, renderHeight, repaintRegion, number, frame.centerX);
+            return;
+        }
+
+        // stagingは直前のフレームの内容を持っているため、今回変化した部分だけを描けばよい
+        // バッファへは、バッファエイジから求めたrepaintRegionの部分を変換して書き込む
+        renderer.drawScene(staging.data(), renderWidth * 4, renderWidth, renderHeight, frameDamage, number, frame.centerX);
+        const PixelKernels &kernels = pixelKernels();
+        uint16_t *data = buffer.data<uint16_t>();
+        const int pitch = bufferPool->getStride() / 2;
+        renderer.tiles().render(renderWidth, renderHeight, repaintRegion, [&](const Tile &tile) {
+            for (int y = tile.y; y < tile.y + tile.h; ++y)
+            {
+                kernels.toRgb565(data + static_cast<size_t>(y) * pitch + tile.x,
+                                 staging.data() + static_cast<size_t>(y) * renderWidth + tile.x, tile.w);
+            }
+        });
+    }
+
+    // 今回のフレームで変化する領域を求め、履歴に記録する
+    void updateDamage(const Frame &frame)
+    {
+        renderer.sceneDamage(frame.centerX, renderWidth, renderHeight, frame.number == 1 || frame.resized,
+                             lastDiamondBounds, frameDamage);
+        damageHistory.push(frameDamage);
+    }
+
+    bool useDamageBuffer() const
+    {
+        return wl_surface_get_version(wlSurface) >= WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION;
+    }
+
+    // 描画したピクセル数の、全フレームを全体描画した場合に対する割合
+    double ratioOfSurface(uint64_t pixels) const
+    {
+        return renderedAreaPixels == 0 ? 0.0 : static_cast<double>(pixels) / renderedAreaPixels;
+    }
+
+    friend class ShmRenderer;
+};
+
+inline std::unique_ptr<RenderTarget> ShmRenderer::createTarget(WaylandConnection::Globals &globals, wl_surface *surface,
+                                                               int width, int height)
+{
+    auto phase = startupTrace().phase("shm_buffer_pool");
+    // 2枚目以降のウィンドウのバッファは、最初のウィンドウと同じアリーナから切り出す
+    ShmRenderTarget *target = new ShmRenderTarget(*this, globals, surface, width, height, arena);
+    if (targets.empty() && options.layers && !target->layered())
+    {
+        std::cout << "[shm] --layers is ignored: it needs --scene diamond and wl_subcompositor" << std::endl;
+    }
+    arena = target->shared();
+    targets.push_back(target);
+    return std::unique_ptr<RenderTarget>(target);
+}
+
+inline void ShmRenderer::reportMemory(std::ostream &os) const
+{
+    if (!arena)
+    {
+        return;
+    }
+    size_t liveBuffers = 0, peakBuffers = 0;
+    for (const ShmRenderTarget *target : targets)
+    {
+        liveBuffers += target->liveBuffers();
+        peakBuffers += target->peakBuffers();
+    }
+    const ShmArena &shmArena = arena->getArena();
+    os << " shm_mapped_kb=" << shmArena.getCapacity() / 1024
+       << " shm_used_kb=" << shmArena.usedBytes() / 1024
+       << " live_buffers=" << liveBuffers
+       << " peak_buffers=" << peakBuffers
+       << " idle_shrinks=" << idleShrinks
+       << " shrunk_kb=" << shrunkBytes / 1024
+       << " idle_trims=" << idleTrims
+       << " trimmed_kb=" << trimmedBytes / 1024;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include "pixel_kernels.h"
+#include "tile_renderer.h"
+
+// CPUで三角形を描画するラスタライザ（wl_shmのバッファ向け）
+// ・頂点はOpenGLと同じ正規化デバイス座標（x, y, z）で受け取り、glViewportと同様にピクセル座標へ変換する
+// ・各辺のエッジ関数の符号で内外を判定する（half-space test）。座標は1/16ピクセルの固定小数点で扱う
+// ・画面を8x8ピクセルのブロックに分け、ブロック全体が外側なら棄却、全体が内側なら矩形塗りつぶし、
+//   境界をまたぐブロックのみピクセル単位で判定する（この部分はpixel_kernels.hのSIMDカーネルが担当）
+// 描画関数はconstで内部状態を持たないため、TileRendererで複数スレッドから同時に呼び出してよい
+class SoftRasterizer
+{
+public:
+    static constexpr int blockSize = 8;
+    static constexpr int subpixelBits = 4;
+    static constexpr int64_t subpixelOne = 1 << subpixelBits;
+
+    SoftRasterizer() : kernels(&pixelKernels()) {}
+
+    // 描画先のバッファを設定する。pitchは1行あたりのピクセル数
+    void setTarget(uint32_t *buffer, int pitch, int width, int height)
+    {
+        this->buffer = buffer;
+        this->pitch = pitch;
+        this->width = width;
+        this->height = height;
+    }
+
+    // 使用するカーネルを固定する（ベンチマークでの実装比較用）
+    void setKernels(const PixelKernels &kernels) { this->kernels = &kernels; }
+
+    // glDrawArrays(GL_TRIANGLE_FAN, 0, count) 相当。verticesは (x, y, z) × count
+    // clipの範囲外のピクセルには書き込まない
+    void drawTriangleFan(const float *vertices, int count, uint32_t color, const Tile &clip) const
+    {
+        for (int i = 1; i + 1 < count; ++i)
+        {
+            drawTriangle(vertices, vertices + i * 3, vertices + (i + 1) * 3, color, clip);
+        }
+    }
+
+    // glDrawArrays(GL_TRIANGLES, 0, count) 相当
+    void drawTriangles(const float *vertices, int count, uint32_t color, const Tile &clip) const
+    {
+        for (int i = 0; i + 2 < count; i += 3)
+        {
+            drawTriangle(vertices + i * 3, vertices + (i + 1) * 3, vertices + (i + 2) * 3, color, clip);
+        }
+    }
+
+    void drawTriangle(const float *a, const float *b, const float *c, uint32_t color, const Tile &clip) const
+    {
+        Point p[3] = {toFixed(a), toFixed(b), toFixed(c)};
+
+        // 極端に大きな座標はエッジ関数が32bitに収まらなくなるため描画しない（GLでのクリッピングに相当）
+        for (const Point &v : p)
+        {
+            if (std::llabs(v.x) > maxCoordinate || std::llabs(v.y) > maxCoordinate)
+            {
+                return;
+            }
+        }
+
+        // 面積が正になるように頂点の順序を揃え、内側で全エッジ関数が正になるようにする
+        const int64_t area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+        if (area == 0)
+        {
+            return;
+        }
+        if (area < 0)
+        {
+            std::swap(p[1], p[2]);
+        }
+
+        // 三角形のバウンディングボックス（ピクセル単位）を、描画先とクリップ領域で切り詰める
+        const int64_t minX = std::min({p[0].x, p[1].x, p[2].x});
+        const int64_t maxX = std::max({p[0].x, p[1].x, p[2].x});
+        const int64_t minY = std::min({p[0].y, p[1].y, p[2].y});
+        const int64_t maxY = std::max({p[0].y, p[1].y, p[2].y});
+        const int x0 = static_cast<int>(std::max<int64_t>({0, clip.x, minX >> subpixelBits}));
+        const int y0 = static_cast<int>(std::max<int64_t>({0, clip.y, minY >> subpixelBits}));
+        const int x1 = static_cast<int>(std::min<int64_t>({width - 1, clip.x + clip.w - 1, maxX >> subpixelBits}));
+        const int y1 = static_cast<int>(std::min<int64_t>({height - 1, clip.y + clip.h - 1, maxY >> subpixelBits}));
+        if (x0 > x1 || y0 > y1)
+        {
+            return;
+        }
+
+        const Edge edges[3] = {makeEdge(p[0], p[1]), makeEdge(p[1], p[2]), makeEdge(p[2], p[0])};
+
+        // ブロックの格子は絶対座標で8の倍数に揃える（タイルの境界と一致させるため）
+        for (int by = y0 & ~(blockSize - 1); by <= y1; by += blockSize)
+        {
+            const int blockY0 = std::max(by, y0);
+            const int blockY1 = std::min(by + blockSize - 1, y1);
+            for (int bx = x0 & ~(blockSize - 1); bx <= x1; bx += blockSize)
+            {
+                const int blockX0 = std::max(bx, x0);
+                const int blockX1 = std::min(bx + blockSize - 1, x1);
+                drawBlock(edges, blockX0, blockY0, blockX1 - blockX0 + 1, blockY1 - blockY0 + 1, color);
+            }
+        }
+    }
+
+private:
+    // 固定小数点（1/16ピクセル）の頂点座標
+    struct Point
+    {
+        int64_t x, y;
+    };
+
+    // エッジ関数 E(px, py) = c + dx * px + dy * py（px, pyはピクセル番号で、評価位置はピクセル中心）
+    // 内側で正になる。トップ・レフトルールの補正をcに含めているため、判定は E > 0 のみでよい
+    struct Edge
+    {
+        int64_t c, dx, dy;
+
+        int64_t at(int px, int py) const { return c + dx * px + dy * py; }
+    };
+
+    static constexpr int64_t maxCoordinate = int64_t(1) << 20;
+
+    Point toFixed(const float *v) const
+    {
+        // glViewport(0, 0, width, height)と同じ変換。Waylandのバッファは上から下へ並ぶため、y軸は反転する
+        const float x = (v[0] + 1.0f) * 0.5f * width;
+        const float y = (1.0f - v[1]) * 0.5f * height;
+        return {static_cast<int64_t>(std::lround(x * subpixelOne)), static_cast<int64_t>(std::lround(y * subpixelOne))};
+    }
+
+    static Edge makeEdge(const Point &a, const Point &b)
+    {
+        // E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+        // 位置pはピクセル中心（px * 16 + 8, py * 16 + 8）
+        const int64_t ex = b.x - a.x;
+        const int64_t ey = b.y - a.y;
+        Edge edge;
+        edge.dx = -ey * subpixelOne;
+        edge.dy = ex * subpixelOne;
+        edge.c = ex * (subpixelOne / 2 - a.y) - ey * (subpixelOne / 2 - a.x);
+
+        // トップ・レフトルール：辺の上にちょうど乗ったピクセルは、上辺・左辺の場合のみ内側とみなす
+        // 隣接する三角形（ファンの共有辺）で同じピクセルを二重に塗ったり、隙間ができたりしないようにする
+        const bool topLeft = (ey == 0 && ex > 0) || ey < 0;
+        if (topLeft)
+        {
+            edge.c += 1;
+        }
+        return edge;
+    }
+
+    void drawBlock(const Edge *edges, int x, int y, int w, int h, uint32_t color) const
+    {
+        int32_t e[3], dx[3], dy[3];
+        bool fullyInside = true;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            // 一次関数なので、ブロック内の最小値・最大値は四隅のいずれかになる
+            const Edge &edge = edges[i];
+            const int64_t corner = edge.at(x, y);
+            const int64_t spanX = edge.dx * (w - 1);
+            const int64_t spanY = edge.dy * (h - 1);
+            const int64_t minValue = corner + std::min<int64_t>(0, spanX) + std::min<int64_t>(0, spanY);
+            const int64_t maxValue = corner + std::max<int64_t>(0, spanX) + std::max<int64_t>(0, spanY);
+
+            if (maxValue <= 0)
+            {
+                // ブロック全体がこの辺の外側（棄却）
+                return;
+            }
+            if (minValue > 0)
+            {
+                // ブロック全体がこの辺の内側。ピクセル単位の判定では常に真になる値を渡す
+                e[i] = 1;
+                dx[i] = 0;
+                dy[i] = 0;
+            }
+            else
+            {
+                // 辺がブロックをまたぐ場合、ブロック内の値は8x8ピクセル分の増分に収まるため32bitで扱える
+                fullyInside = false;
+                e[i] = static_cast<int32_t>(corner);
+                dx[i] = static_cast<int32_t>(edge.dx);
+                dy[i] = static_cast<int32_t>(edge.dy);
+            }
+        }
+
+        if (fullyInside)
+        {
+            kernels->fillRect(buffer, pitch, x, y, w, h, color);
+        }
+        else
+        {
+            kernels->triangleBlock(buffer + static_cast<size_t>(y) * pitch + x, pitch, w, h, e, dx, dy, color);
+        }
+    }
+
+    const PixelKernels *kernels;
+    uint32_t *buffer = nullptr;
+    int pitch = 0;
+    int width = 0;
+    int height = 0;
+};
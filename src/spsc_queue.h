@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// 1つのスレッドだけがpushし、別の1つのスレッドだけがpopするロックフリーのリングバッファ
+// ・容量は2のべき乗（インデックスの剰余をマスクで計算するため）
+// ・head/tailは単調に増やし続け、差が要素数になる（size_tの周回は差の計算に影響しない）
+// ・push側はtailのみ、pop側はheadのみを書き換える。要素の書き込み/読み出しはrelease/acquireで相手に公開する
+// ・headとtailは別のキャッシュラインに置き、2つのスレッド間でのキャッシュラインの奪い合い（false sharing）を避ける
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // 満杯の場合はfalseを返す（要素は書き込まれない）
+    bool push(const T &value)
+    {
+        const size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        slots[tail & (Capacity - 1)] = value;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 空の場合はfalseを返す
+    bool pop(T &value)
+    {
+        const size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = slots[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+    alignas(64) T slots[Capacity];
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 起動処理の各段階にかかった時間を記録する
+// 環境変数 MY_WAYLAND_CLIENT_STARTUP_TRACE が設定されている場合のみ、最初のフレームが表示された時点でJSONを出力する
+// ・"1" または "stderr" : 標準エラー出力
+// ・それ以外            : その値をファイルパスとして書き込む（上書き）
+// 時刻はすべてプロセス内で最初にstartupTrace()を呼んだ時点からの経過時間（ms、steady_clock）
+// 起動処理の一部はワーカースレッドで並行して行われるため、記録は複数のスレッドから呼ばれてもよい
+//
+// 使い方：
+//   {
+//       auto phase = startupTrace().phase("wl_display_connect");
+//       ... // スコープを抜けた時点で終了時刻が記録される
+//   }
+//   startupTrace().finish();
+class StartupTrace
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // スコープの開始から終了までを1つの段階として記録する
+    class Phase
+    {
+    public:
+        Phase(StartupTrace &trace, const char *name) : trace(trace), name(name), start(Clock::now()) {}
+        ~Phase() { trace.record(name, start, Clock::now()); }
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+    private:
+        StartupTrace &trace;
+        const char *name;
+        Clock::time_point start;
+    };
+
+    StartupTrace() : origin(Clock::now())
+    {
+        const char *target = std::getenv("MY_WAYLAND_CLIENT_STARTUP_TRACE");
+        if (target && *target)
+        {
+            output = target;
+            entries.reserve(32);
+        }
+    }
+
+    bool enabled() const { return !output.empty(); }
+
+    // 出力に含めるプログラム名（"egl" / "shm"）
+    void setBinary(const char *name) { binary = name; }
+
+    // C++17では戻り値のコピーが省略されるため、コピー不可のPhaseをそのまま返せる
+    Phase phase(const char *name) { return Phase(*this, name); }
+
+    // 時間幅を持たない出来事（最初のフレームの提示など）を記録する
+    void mark(const char *name)
+    {
+        const auto now = Clock::now();
+        record(name, now, now);
+    }
+
+    // 記録した内容を出力する。2回目以降の呼び出しは何もしない
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enabled() || finished)
+        {
+            return;
+        }
+        finished = true;
+
+        std::string json = "{\"binary\":\"" + binary + "\",\"phases\":[";
+        char line[256];
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const Entry &entry = entries[i];
+            std::snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"start_ms\":%.3f,\"duration_ms\":%.3f}",
+                          i == 0 ? "" : ",", entry.name, msSinceOrigin(entry.start),
+                          std::chrono::duration<double, std::milli>(entry.end - entry.start).count());
+            json += line;
+        }
+        std::snprintf(line, sizeof(line), "],\"total_ms\":%.3f}\n", msSinceOrigin(Clock::now()));
+        json += line;
+
+        const bool toStderr = output == "1" || output == "stderr";
+        FILE *file = toStderr ? stderr : std::fopen(output.c_str(), "w");
+        if (!file)
+        {
+            std::fprintf(stderr, "startup trace: failed to open %s\n", output.c_str());
+            return;
+        }
+        std::fputs(json.c_str(), file);
+        if (!toStderr)
+        {
+            std::fclose(file);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        const char *name;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    void record(const char *name, Clock::time_point start, Clock::time_point end)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!finished)
+        {
+            entries.push_back({name, start, end});
+        }
+    }
+
+    double msSinceOrigin(Clock::time_point t) const
+    {
+        return std::chrono::duration<double, std::milli>(t - origin).count();
+    }
+
+    Clock::time_point origin;
+    std::string output;
+    std::string binary = "unknown";
+    std::vector<Entry> entries;
+    bool finished = false;
+    std::mutex mutex;
+};
+
+// プロセス全体で共有する記録先
+inline StartupTrace &startupTrace()
+{
+    static StartupTrace trace;
+    return trace;
+}
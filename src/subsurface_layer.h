@@ -0,0 +1,79 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <memory>
+#include "shm_buffer_pool.h"
+
+// wl_subsurfaceとして親サーフェスの上に重ねる、独自のバッファを持つ1枚のレイヤー
+// 変化しない部分（背景）と変化する部分を別々のサーフェスに分けることで、変化したレイヤーだけを描画・コミットできる
+//
+// コミットの同期モード：
+// ・synchronized（既定）：レイヤーのコミットは親サーフェスの次のコミットまで保留され、親と同時に反映される。
+//   位置（set_position）は常に親のコミットで反映されるため、移動するレイヤーはこちらを使い、親と一緒に更新する
+// ・desynchronized：レイヤーのコミットは即座に反映される。位置を変えずに内容だけが変わるレイヤー向け
+//   （親をコミットしないため、親の再合成やフレームコールバックと独立して更新できる）
+class SubsurfaceLayer
+{
+public:
+    // バッファは親のプールと同じアリーナ（shared）から切り出す
+    // bufferCountは内容を書き換えない場合は1、毎フレーム描き直す場合は2以上
+    SubsurfaceLayer(wl_compositor *compositor, wl_subcompositor *subcompositor, wl_surface *parent, wl_shm *shm,
+                    int width, int height, uint32_t format, int bufferCount,
+                    std::shared_ptr<SharedShmPool> shared)
+        : width(width), height(height)
+    {
+        wlSurface = wl_compositor_create_surface(compositor);
+        subsurface = wl_subcompositor_get_subsurface(subcompositor, wlSurface, parent);
+        buffers.reset(new ShmBufferPool(shm, width, height, format, bufferCount, bufferCount, shared));
+    }
+
+    ~SubsurfaceLayer()
+    {
+        buffers.reset();
+        wl_subsurface_destroy(subsurface);
+        wl_surface_destroy(wlSurface);
+    }
+
+    SubsurfaceLayer(const SubsurfaceLayer &) = delete;
+    SubsurfaceLayer &operator=(const SubsurfaceLayer &) = delete;
+
+    // 親サーフェスの左上を原点とした位置を指定する（親の次のコミットで反映される）
+    // 位置が変わらない場合はリクエストを送らない
+    void setPosition(int x, int y)
+    {
+        if (positioned && x == posX && y == posY)
+        {
+            return;
+        }
+        wl_subsurface_set_position(subsurface, x, y);
+        posX = x;
+        posY = y;
+        positioned = true;
+    }
+
+    void setSynchronized(bool sync)
+    {
+        if (sync)
+        {
+            wl_subsurface_set_sync(subsurface);
+        }
+        else
+        {
+            wl_subsurface_set_desync(subsurface);
+        }
+    }
+
+    wl_surface *surface() const { return wlSurface; }
+    ShmBufferPool &pool() { return *buffers; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getX() const { return posX; }
+
+private:
+    int width, height;
+    wl_surface *wlSurface = nullptr;
+    wl_subsurface *subsurface = nullptr;
+    std::unique_ptr<ShmBufferPool> buffers;
+    int posX = 0, posY = 0;
+    bool positioned = false;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ワークスティーリング方式のスレッドプール
+// parallelFor()で渡されたインデックスを各ワーカーのキューに連続区間で割り振り、
+// 自分のキューが空になったワーカーは他のワーカーのキューの末尾から仕事を盗む
+// 呼び出し元のスレッドもワーカー0として処理に参加する
+// キューは事前確保した配列で管理するため、定常状態でのparallelFor()はメモリ確保を行わない
+class ThreadPool
+{
+public:
+    // threadCountは呼び出し元スレッドを含めた並列数。0の場合はCPUのコア数
+    explicit ThreadPool(unsigned threadCount = 0)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 0; i < threadCount; ++i)
+        {
+            queues.emplace_back(new Queue);
+        }
+        for (unsigned i = 1; i < threadCount; ++i)
+        {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    // fn(i) を i = 0 .. count-1 について並列に実行し、全て完了するまで待つ
+    template <typename F>
+    void parallelFor(size_t count, F &&fn)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        using Fn = typename std::remove_reference<F>::type;
+        invoke = [](void *context, size_t index) { (*static_cast<Fn *>(context))(index); };
+        context = const_cast<void *>(static_cast<const void *>(&fn));
+        remaining.store(count, std::memory_order_relaxed);
+
+        // 隣接するタイルが同じワーカーに割り当たるよう、連続区間で分配する
+        const size_t n = queues.size();
+        for (size_t q = 0; q < n; ++q)
+        {
+            Queue &queue = *queues[q];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            const size_t begin = count * q / n;
+            const size_t end = count * (q + 1) / n;
+            if (queue.items.size() < end - begin)
+            {
+                queue.items.resize(end - begin);
+            }
+            for (size_t i = begin; i < end; ++i)
+            {
+                queue.items[i - begin] = i;
+            }
+            queue.head = 0;
+            queue.tail = end - begin;
+        }
+
+        if (!workers.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++generation;
+            }
+            wakeCv.notify_all();
+        }
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCv.wait(lock, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+    }
+
+    // これまでに他のワーカーから盗んだタスクの数（負荷分散の確認用）
+    uint64_t stealCount() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<size_t> items;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    // 自分のキューの先頭から取り出し、空なら他のキューの末尾から盗む
+    bool pop(unsigned self, size_t &item)
+    {
+        {
+            Queue &own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.head < own.tail)
+            {
+                item = own.items[own.head++];
+                return true;
+            }
+        }
+
+        const size_t n = queues.size();
+        for (size_t i = 1; i < n; ++i)
+        {
+            Queue &victim = *queues[(self + i) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.head < victim.tail)
+            {
+                item = victim.items[--victim.tail];
+                steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void runTasks(unsigned self)
+    {
+        size_t item;
+        while (pop(self, item))
+        {
+            invoke(context, item);
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                // 最後のタスクを終えたスレッドが完了を通知する
+                std::lock_guard<std::mutex> lock(mutex);
+                doneCv.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(unsigned self)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+            runTasks(self);
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCv;
+    std::condition_variable doneCv;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void (*invoke)(void *, size_t) = nullptr;
+    void *context = nullptr;
+    std::atomic<size_t> remaining{0};
+    std::atomic<uint64_t> steals{0};
+};
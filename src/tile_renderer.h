@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "damage_region.h"
+#include "thread_pool.h"
+
+// 描画対象の矩形領域（ピクセル単位）
+struct Tile
+{
+    int x, y, w, h;
+};
+
+// 画面をキャッシュに収まる大きさのタイルに分割し、スレッドプールで並列に描画する
+// 既定の64x64ピクセルは1タイル16KBで、L1/L2キャッシュに収まる
+// タイルの一覧は画面サイズが変わった時のみ作り直す
+class TileRenderer
+{
+public:
+    explicit TileRenderer(ThreadPool &pool, int tileSize = 64) : pool(pool), tileSize(tileSize) {}
+
+    // fn(const Tile &) を全タイルについて呼び出し、全て完了してから戻る
+    template <typename F>
+    void render(int width, int height, F &&fn)
+    {
+        if (width != tilesWidth || height != tilesHeight)
+        {
+            buildTiles(width, height);
+        }
+        pool.parallelFor(tiles.size(), [&](size_t index) { fn(tiles[index]); });
+    }
+
+    // regionに含まれる部分のみを描画する。各矩形はタイルの格子で分割され、fnにはその断片が渡される
+    // regionの矩形は互いに重ならないため、同じピクセルが複数のスレッドから書かれることはない
+    template <typename F>
+    void render(int width, int height, const DamageRegion &region, F &&fn)
+    {
+        regionTiles.clear();
+        const Rect screen{0, 0, width, height};
+        for (const Rect &damage : region)
+        {
+            const Rect rect = damage.intersected(screen);
+            if (rect.empty())
+            {
+                continue;
+            }
+            for (int y = rect.y / tileSize * tileSize; y < rect.y + rect.h; y += tileSize)
+            {
+                for (int x = rect.x / tileSize * tileSize; x < rect.x + rect.w; x += tileSize)
+                {
+                    const Rect piece = rect.intersected(Rect{x, y, tileSize, tileSize});
+                    regionTiles.push_back({piece.x, piece.y, piece.w, piece.h});
+                }
+            }
+        }
+        pool.parallelFor(regionTiles.size(), [&](size_t index) { fn(regionTiles[index]); });
+    }
+
+    ThreadPool &getPool() { return pool; }
+    size_t tileCount() const { return tiles.size(); }
+
+private:
+    void buildTiles(int width, int height)
+    {
+        tiles.clear();
+        for (int y = 0; y < height; y += tileSize)
+        {
+            for (int x = 0; x < width; x += tileSize)
+            {
+                tiles.push_back({x, y, std::min(tileSize, width - x), std::min(tileSize, height - y)});
+            }
+        }
+        tilesWidth = width;
+        tilesHeight = height;
+    }
+
+    ThreadPool &pool;
+    int tileSize;
+    int tilesWidth = -1, tilesHeight = -1;
+    std::vector<Tile> tiles;
+    // 部分描画用。容量は使い回すため、定常状態ではメモリ確保は発生しない
+    std::vector<Tile> regionTiles;
+};
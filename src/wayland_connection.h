@@ -0,0 +1,164 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "presentation_feedback.h"
+#include "protocol_stats.h"
+#include "seat_input.h"
+#include "startup_trace.h"
+#include "viewporter-client-protocol.h"
+#include "xdg_toplevel.h"
+
+// Waylandディスプレイサーバーへの接続と、レジストリから取得するグローバル
+// 描画バックエンド（EGL/GLESのegl_renderer.h、wl_shmのshm_renderer.h）に共通の部分
+// バックエンドが違っても、接続・ウィンドウの管理（xdg-shell）・入力・表示時刻のフィードバックは同じものを使う
+class WaylandConnection
+{
+public:
+    struct Globals
+    {
+        // compositorは、クライアントが画面にウィンドウやサーフェスを描画するのに必要なオブジェクト
+        wl_compositor *compositor = nullptr;
+        // shell（xdg_wm_base）は、ウィンドウの管理やユーザーインターフェースの一部を担うオブジェクト
+        XdgShell shell;
+        wl_shm *shm = nullptr;
+        // wl_shm.formatイベントで通知された、コンポジタが受け付けるピクセルフォーマット
+        // ARGB8888とXRGB8888はすべてのコンポジタが対応している（プロトコルで必須）
+        bool xrgb8888 = false;
+        bool rgb565 = false;
+        // サブサーフェスの作成に使う。コンポジタが対応していない場合はnullptrのまま
+        wl_subcompositor *subcompositor = nullptr;
+        // サーフェスの拡大縮小（wp_viewporter）。コンポジタが対応していない場合はnullptrのまま
+        wp_viewporter *viewporter = nullptr;
+        // 表示時刻のフィードバック（wp_presentation）。コンポジタが対応していない場合は無効のまま
+        PresentationFeedback presentation;
+        // ポインタとキーボード（wl_seat）。ウィンドウが複数ある場合は共有し、ポインタが入ったサーフェスでウィンドウを区別する
+        SeatInput input;
+    };
+
+    // 接続だけを行う。グローバルの取得はbindGlobals()で行う
+    // （EGLの初期化のように、接続さえあれば始められる処理をその間に並行して進められるよう分けている）
+    WaylandConnection()
+    {
+        std::cout << "Waylandディスプレイサーバーへの接続" << std::endl;
+        // NULLを指定すると、環境変数[WAYLAND_DISPLAY]に設定されているサーバー
+        // 環境変数がなければ “wayland-0” という名前のサーバーに接続
+        auto phase = startupTrace().phase("wl_display_connect");
+        wlDisplay = wl_display_connect(nullptr);
+        assert(wlDisplay);
+        // これ以降、この接続の通信量を数える
+        protocolStats().attach(wlDisplay);
+    }
+
+    // サーフェス等のプロキシは、すべてこれより先に破棄すること
+    ~WaylandConnection()
+    {
+        globals.shell.destroy();
+        globals.presentation.destroy();
+        globals.input.destroy();
+        if (registry)
+        {
+            wl_registry_destroy(registry);
+        }
+        protocolStats().detach();
+        wl_display_disconnect(wlDisplay);
+    }
+
+    WaylandConnection(const WaylandConnection &) = delete;
+    WaylandConnection &operator=(const WaylandConnection &) = delete;
+
+    // レジストリからグローバルを取得する
+    // shmFormatsがtrueの場合は、バインドしたwl_shmから届く対応フォーマットの一覧も待つ（ラウンドトリップがもう1回増える）
+    void bindGlobals(bool shmFormats)
+    {
+        // ディスプレイサーバーとのI/Fで、何が使用可能なのかを取得
+        // クライアントはレジストリからのイベントを購読し、それらのイベントが発生したときに特定のアクションを実行するためのコールバック関数（registryListener）を指定
+        registry = wl_display_get_registry(wlDisplay);
+        wl_registry_add_listener(registry, &registryListener, &globals);
+
+        // 全リクエストがサーバーに送信され、サーバーからのすべてのイベントがアプリケーションによって処理されるまで「待機」
+        // レジストリのglobalイベントはwl_display_syncの応答より先に届くため、1回のラウンドトリップで全て揃う
+        {
+            auto phase = startupTrace().phase("wl_display_roundtrip");
+            wl_display_roundtrip(wlDisplay);
+        }
+        // wl_shm.formatはバインドのリクエストへの応答として届くため、もう1回待つ
+        if (shmFormats && globals.shm)
+        {
+            auto phase = startupTrace().phase("wl_shm_formats");
+            wl_display_roundtrip(wlDisplay);
+        }
+
+        assert(globals.compositor && globals.shell.supported());
+    }
+
+    wl_display *display() const { return wlDisplay; }
+    Globals &wayland() { return globals; }
+    const Globals &wayland() const { return globals; }
+
+private:
+    static void registryGlobal(void *data, wl_registry *registry, uint32_t id, const char *interface, uint32_t version)
+    {
+        auto *globals = static_cast<Globals *>(data);
+
+        if (std::strcmp(interface, "wl_compositor") == 0)
+        {
+            // wl_surface.damage_buffer（バージョン4以降）を使うため、対応していれば4でバインドする
+            globals->compositor = static_cast<wl_compositor *>(
+                wl_registry_bind(registry, id, &wl_compositor_interface, std::min<uint32_t>(version, 4)));
+        }
+        else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0)
+        {
+            globals->shell.bind(registry, id);
+        }
+        else if (std::strcmp(interface, "wl_shm") == 0)
+        {
+            globals->shm = static_cast<wl_shm *>(wl_registry_bind(registry, id, &wl_shm_interface, 1));
+            wl_shm_add_listener(globals->shm, &shmListener, globals);
+        }
+        else if (std::strcmp(interface, "wl_subcompositor") == 0)
+        {
+            globals->subcompositor = static_cast<wl_subcompositor *>(
+                wl_registry_bind(registry, id, &wl_subcompositor_interface, 1));
+        }
+        else if (std::strcmp(interface, wp_presentation_interface.name) == 0)
+        {
+            globals->presentation.bind(registry, id);
+        }
+        else if (std::strcmp(interface, wp_viewporter_interface.name) == 0)
+        {
+            globals->viewporter = static_cast<wp_viewporter *>(wl_registry_bind(registry, id, &wp_viewporter_interface, 1));
+        }
+        else if (std::strcmp(interface, "wl_seat") == 0)
+        {
+            globals->input.bind(registry, id, version);
+        }
+    }
+
+    static void shmFormat(void *data, wl_shm *, uint32_t format)
+    {
+        auto *globals = static_cast<Globals *>(data);
+        if (format == WL_SHM_FORMAT_XRGB8888)
+        {
+            globals->xrgb8888 = true;
+        }
+        else if (format == WL_SHM_FORMAT_RGB565)
+        {
+            globals->rgb565 = true;
+        }
+    }
+
+    static const wl_registry_listener registryListener;
+    static const wl_shm_listener shmListener;
+
+    wl_display *wlDisplay = nullptr;
+    wl_registry *registry = nullptr;
+    Globals globals;
+};
+
+inline const wl_registry_listener WaylandConnection::registryListener = {WaylandConnection::registryGlobal, nullptr};
+inline const wl_shm_listener WaylandConnection::shmListener = {WaylandConnection::shmFormat};
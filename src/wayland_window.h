@@ -0,0 +1,928 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event_loop.h"
+#include "frame_stats.h"
+#include "process_memory.h"
+#include "protocol_stats.h"
+#include "renderer.h"
+#include "resolution_controller.h"
+#include "run_options.h"
+#include "run_summary.h"
+#include "scene.h"
+#include "seat_input.h"
+#include "spsc_queue.h"
+#include "startup_trace.h"
+#include "viewporter-client-protocol.h"
+#include "wayland_connection.h"
+#include "xdg_toplevel.h"
+
+// 1つのWayland接続と、その上のすべてのウィンドウ（WaylandWindow）で共有するもの
+// ・イベントループ：Waylandの接続・シグナル・タイマーを1つのepollで待つ
+// ・描画バックエンド（Renderer）：EGLのコンテキストやwl_shmのアリーナなど
+// ウィンドウはすべてこれより先に破棄すること
+class WaylandClient
+{
+public:
+    explicit WaylandClient(std::unique_ptr<Renderer> backend)
+        : connection(new WaylandConnection), backend(std::move(backend))
+    {
+        // 起動処理のうち、レジストリの取得（ラウンドトリップ）と互いに依存しないバックエンドの準備は並行して進める
+        // （EGLはワーカースレッドで初期化を始め、最初のウィンドウの描画先を作る時にその完了を待つ）
+        this->backend->connect(connection->display());
+        connection->bindGlobals(this->backend->needsShmFormats());
+    }
+
+    WaylandClient(const WaylandClient &) = delete;
+    WaylandClient &operator=(const WaylandClient &) = delete;
+
+    wl_display *display() const { return connection->display(); }
+    WaylandConnection::Globals &wayland() { return connection->wayland(); }
+    EventLoop &loop() { return eventLoop; }
+    Renderer &renderer() { return *backend; }
+
+    // 描画を続けているウィンドウの数。すべてのウィンドウが指定フレーム数に達したらイベントループを終了する
+    void addWindow() { ++activeWindows; }
+    void windowFinished()
+    {
+        if (--activeWindows == 0)
+        {
+            eventLoop.quit();
+        }
+    }
+
+private:
+    EventLoop eventLoop;
+    // バックエンド（EGLディスプレイ等）は接続を使っているため、接続より先に破棄する（宣言の逆順）
+    std::unique_ptr<WaylandConnection> connection;
+    std::unique_ptr<Renderer> backend;
+    int activeWindows = 0;
+};
+
+// メインスレッドから描画スレッドへの指示
+// 入力のイベントはメインスレッドで受け取り、ウィンドウの状態を変えるものだけをこの形で描画スレッドに渡す
+struct RenderCommand
+{
+    enum class Kind
+    {
+        Stop,    // 描画を終了してスレッドを抜ける
+        Pointer, // ポインタの状態が変わった（pointer）
+        Pause,   // スペースキー：アニメーションの停止と再開
+        Resize,  // ウィンドウのサイズが変わった（width x height。新しいサイズのフレームの前にserialのconfigureにackする）
+    } kind;
+    // wl_pointer.frameで確定したポインタの状態
+    SeatInput::PointerState pointer;
+    int width = 0, height = 0;
+    uint32_t serial = 0;
+    // 変化を受信した時刻（input-to-commit・resize-to-commitの計測の起点。0の場合は計測しない）
+    uint64_t sinceNs = 0;
+};
+
+// 途中経過の出力に使う、最新のフレームの状態
+struct FrameReport
+{
+    uint64_t frames;
+    double frameMs;
+};
+
+// 1枚のウィンドウ：wl_surfaceとxdg_toplevel、およびそのウィンドウの描画の状態（フレームコールバック・入力・解像度・統計）
+// バッファへの描画と提示は、描画バックエンドが作る描画先（RenderTarget）が行う
+class WaylandWindow
+{
+public:
+    WaylandWindow(WaylandClient &client, int width, int height, const RunOptions &runOptions, int index = 0)
+        : client(client), index(index), width(width), height(height), renderWidth(width), renderHeight(height),
+          options(runOptions), resolution(runOptions.frameBudgetMs)
+    {
+        client.addWindow();
+        // サーフェスの作成はバックエンドの準備と並行して進め、描画先の作成だけがその完了を待つ
+        initSurface();
+        target = client.renderer().createTarget(client.wayland(), wlSurface, this->width, this->height);
+        initViewport();
+    }
+
+    ~WaylandWindow()
+    {
+        if (idleTimer >= 0)
+        {
+            frameLoop->removeSource(idleTimer);
+        }
+        if (frameCallback)
+        {
+            wl_callback_destroy(frameCallback);
+        }
+        // 描画先（バッファ・EGLサーフェス・サブサーフェス）はwl_surfaceより先に破棄する
+        target.reset();
+        if (viewport)
+        {
+            wp_viewport_destroy(viewport);
+        }
+        toplevel.reset();
+        if (renderQueue)
+        {
+            // ラッパーとキューは、そこに属するプロキシ（フレームコールバック等）をすべて破棄した後に破棄する
+            wl_proxy_wrapper_destroy(frameSurface);
+            wl_event_queue_destroy(renderQueue);
+            close(renderWakeFd);
+        }
+        if (wlSurface)
+        {
+            wl_surface_destroy(wlSurface);
+        }
+    }
+
+    WaylandWindow(const WaylandWindow &) = delete;
+    WaylandWindow &operator=(const WaylandWindow &) = delete;
+
+    // ウィンドウを描画し続け、終了後に統計を出力する
+    // 全ウィンドウのフレームコールバックを同じイベントループ（client.loop()）で処理する
+    // 描画スレッド（--render-thread）はウィンドウが1つの場合のみ
+    static void run(WaylandClient &client, const std::vector<WaylandWindow *> &windows)
+    {
+        WaylandWindow &first = *windows.front();
+        const RunOptions &options = first.options;
+        Renderer &renderer = client.renderer();
+        const std::string name = renderer.name();
+
+        const auto start = FrameStats::Clock::now();
+        RunSummary summary;
+        summary.begin();
+        for (WaylandWindow *window : windows)
+        {
+            window->startTime = start;
+            window->paused = options.onDemand;
+            window->pausedAt = start;
+        }
+        first.initEventLoop(renderer.name());
+        initInput(client, windows);
+        protocolStats().setPhase("frames");
+
+        if (options.renderThread)
+        {
+            // 描画は描画スレッドで行い、メインスレッドは既定のキューのイベント（レジストリ・シェル・入力等）の処理を続ける
+            first.startRenderThread();
+            client.loop().run();
+            first.stopRenderThread();
+        }
+        else
+        {
+            renderFrames(client.loop(), windows);
+        }
+        const double seconds = std::chrono::duration<double>(FrameStats::Clock::now() - start).count();
+
+        // 最初のフレームが表示される前に終了した場合も、そこまでの記録を出力する
+        startupTrace().finish();
+
+        // 最初のウィンドウの統計と、全ウィンドウの合計
+        uint64_t totalFrames = 0;
+        double totalCostMs = 0.0;
+        for (const WaylandWindow *window : windows)
+        {
+            totalFrames += window->frameCount;
+            totalCostMs += window->frameCostMs;
+        }
+        first.stats.report(std::cout, options.uncapped ? (name + " uncapped").c_str() : name.c_str());
+        renderer.report(std::cout, totalFrames);
+        first.target->report(std::cout);
+        if (first.resolution.enabled())
+        {
+            std::cout << "[" << name << "] render_scale=" << first.resolution.scale()
+                      << " render_size=" << first.renderWidth << "x" << first.renderHeight
+                      << " scale_changes=" << first.resolution.changeCount() << std::endl;
+        }
+        // frame_costは1ウィンドウ1フレームあたりの描画処理（描画の開始からコミットまで）の時間
+        std::cout << "[" << name << "] windows=" << windows.size()
+                  << " frames=" << totalFrames
+                  << " fps_total=" << (seconds > 0.0 ? totalFrames / seconds : 0.0)
+                  << " frame_cost_ms=" << (totalFrames == 0 ? 0.0 : totalCostMs / totalFrames) << std::endl;
+        // EGLのバックバッファは、GPUのメモリ（dma-buf）の場合はrss_kbに含まれない
+        std::cout << "[" << name << " memory] rss_kb=" << process_memory::residentKb()
+                  << " peak_rss_kb=" << process_memory::peakResidentKb()
+                  << " pss_kb=" << process_memory::proportionalKb()
+                  << " shm_resident_kb=" << process_memory::sharedResidentKb()
+                  << " low_memory=" << (options.lowMemory ? "yes" : "no");
+        renderer.reportMemory(std::cout);
+        std::cout << std::endl;
+        client.wayland().presentation.report(std::cout, (name + " presentation").c_str());
+        client.wayland().input.report(std::cout, (name + " input").c_str());
+        first.toplevel->report(std::cout, (name + " resize").c_str());
+        // 全ウィンドウの通信の合計（1フレームは1ウィンドウ分のコミット）
+        protocolStats().report(std::cout, (name + " protocol").c_str());
+
+        // バックエンドの比較用の要約（最初のウィンドウ）
+        summary.backend = renderer.name();
+        summary.scene = renderer.sceneName();
+        summary.fullDamage = options.fullDamage;
+        summary.width = first.width;
+        summary.height = first.height;
+        summary.frameCostMs = first.frameCostMs;
+        summary.print(std::cout, first.stats);
+    }
+
+private:
+    WaylandClient &client;
+    // ウィンドウの番号（0が最初のウィンドウ）。起動時間の計測と表示時刻のフィードバックは最初のウィンドウのみ
+    int index;
+    // 表示サイズ（サーフェス座標）と、実際に描画するバッファのサイズ
+    // 動的解像度が無効な場合は同じ
+    int width, height;
+    int renderWidth, renderHeight;
+    wl_surface *wlSurface = nullptr;
+    std::unique_ptr<XdgToplevel> toplevel;
+    std::unique_ptr<RenderTarget> target;
+    wl_callback *frameCallback = nullptr;
+
+    RunOptions options;
+    FrameStats stats;
+    FrameStats::Clock::time_point startTime;
+    // 指定フレーム数を描画し終えたかどうか
+    bool finished = false;
+    // アニメーションの停止（--on-demand、スペースキー）
+    // 停止中は入力があった時だけ描画する。アニメーションの時刻は停止していた時間の分だけ遅らせる
+    bool paused = false;
+    FrameStats::Clock::time_point pausedAt;
+    FrameStats::Clock::duration pausedTotal{};
+    // フレームコールバックを待っている間に、入力によって再描画が要求された
+    bool redrawRequested = false;
+    // 描画処理にかかった時間の合計（ms。描画を見送ったフレームの分も含む）
+    double frameCostMs = 0.0;
+    uint64_t frameCount = 0;
+    // このウィンドウの描画に反映したポインタの状態（描画スレッドがある場合は、描画スレッドに渡されたもの）
+    SeatInput::PointerState pointerState;
+
+    // 動的解像度（--frame-budget）
+    // 描画サイズを変えたフレームは、バッファが作り直されるため全体を描き直す
+    ResolutionController resolution;
+    wp_viewport *viewport = nullptr;
+    bool renderSizeChanged = false;
+
+    // 描画が止まっている間のメモリの返却（--low-memory）
+    // idleTimerは描画先のtrim()を呼ぶまでのタイマー（-1は停止中）
+    int idleTimer = -1;
+
+    // 描画スレッド（--render-thread）
+    // frameLoop/frameSurfaceは、フレームコールバックを処理するイベントループと、コールバックを要求するサーフェス
+    // 描画スレッドを使わない場合は、メインスレッドのイベントループ（client.loop()）とwlSurfaceそのもの
+    EventLoop *frameLoop = &client.loop();
+    wl_surface *frameSurface = nullptr;
+    std::unique_ptr<EventLoop> renderLoop;
+    wl_event_queue *renderQueue = nullptr;
+    int renderWakeFd = -1;
+    std::thread renderThread;
+    SpscQueue<RenderCommand, 64> renderCommands;
+    // 描画スレッドが終了した（満杯のキューへのpushを待たないように）
+    std::atomic<bool> renderDone{false};
+    // 描画スレッドが反映した入力とサイズの変更のうち、まだコミットしていない最初のものの受信時刻
+    uint64_t inputSinceNs = 0;
+    uint64_t resizeSinceNs = 0;
+    // 描画スレッドが毎フレーム上書きし、メインスレッドが途中経過の出力時に読む最新の値
+    // キューと違って溜まらないため、メインスレッドが長く止まっていても常に最新のフレームが読める
+    std::atomic<uint64_t> reportedFrames{0};
+    std::atomic<double> reportedFrameMs{0.0};
+
+    static const wl_callback_listener frameListener;
+
+    // windowsのフレームの描画を続ける。loopはフレームコールバックが届くイベントキューをディスパッチするイベントループ
+    static void renderFrames(EventLoop &loop, const std::vector<WaylandWindow *> &windows)
+    {
+        if (windows.front()->options.uncapped)
+        {
+            // フレームペーシングを無効にし、描画処理そのもののスループットを計測するためのモード
+            // （描画先の作成時にeglSwapInterval(0)を設定済みのため、eglSwapBuffersはフレームコールバックを待たずに戻る）
+            // 待機はせず（タイムアウト0）、届いているイベント・シグナル・タイマーの処理だけを行って描画を続ける
+            while (loop.isRunning() && loop.dispatch(0))
+            {
+                for (WaylandWindow *window : windows)
+                {
+                    if (!window->finished)
+                    {
+                        window->redraw();
+                    }
+                }
+            }
+        }
+        else
+        {
+            // 最初のフレームを描画すると同時にフレームコールバックを要求する
+            // 以降はコンポジタから次のフレームを要求される（frameDoneが呼ばれる）たびに再描画する
+            for (WaylandWindow *window : windows)
+            {
+                window->redraw();
+            }
+
+            // Waylandディスプレイサーバーからのイベントを処理する
+            // イベントループはイベントが届くまでepoll_waitで待機し、届いたイベントに対応するリスナー関数を呼び出す
+            // 終了が要求されるか、接続でエラーが発生するまでイベントを処理し続ける
+            loop.run();
+        }
+    }
+
+    // 描画スレッドを起動する
+    // ・フレームコールバックと表示時刻のフィードバックは専用のイベントキュー（renderQueue）に届くようにし、描画スレッドが処理する
+    //   （wl_surfaceのラッパーにキューを設定し、そこから要求したwl_callbackはラッパーのキューに属する）
+    // ・描画先（EGLコンテキストとサーフェス）は描画スレッドで使う（コンテキストは同時に1つのスレッドでしかカレントにできない）
+    // ・スレッド間のやり取りは、メイン→描画の指示をSPSCキューで、描画→メインのフレームの状態をアトミック変数で行う
+    void startRenderThread()
+    {
+        renderQueue = wl_display_create_queue(client.display());
+        frameSurface = static_cast<wl_surface *>(wl_proxy_create_wrapper(wlSurface));
+        wl_proxy_set_queue(reinterpret_cast<wl_proxy *>(frameSurface), renderQueue);
+        client.wayland().presentation.setQueue(renderQueue);
+        // configureはメインスレッドで受け取り、サイズが変わった場合のackは新しいサイズを反映する描画スレッドが送る
+        toplevel->setDeferResizeAck(true);
+
+        renderLoop.reset(new EventLoop);
+        renderLoop->setDisplay(client.display(), renderQueue);
+        // 指示をコマンドキューにpushした後、eventfdで描画スレッドのepoll_waitを起こす
+        renderWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (renderWakeFd < 0)
+        {
+            throw std::runtime_error("Failed to create eventfd");
+        }
+        renderLoop->addFd(renderWakeFd, EPOLLIN, [this](uint32_t) {
+            uint64_t value;
+            while (read(renderWakeFd, &value, sizeof(value)) > 0)
+            {
+            }
+            RenderCommand command;
+            while (renderCommands.pop(command))
+            {
+                switch (command.kind)
+                {
+                case RenderCommand::Kind::Stop:
+                    renderLoop->quit();
+                    break;
+                case RenderCommand::Kind::Pointer:
+                    applyTimed(inputSinceNs, command.sinceNs, [&] { return applyPointer(command.pointer); });
+                    break;
+                case RenderCommand::Kind::Pause:
+                    applyTimed(inputSinceNs, command.sinceNs, [this] { return togglePause(); });
+                    break;
+                case RenderCommand::Kind::Resize:
+                    toplevel->ackConfigure(command.serial);
+                    applyTimed(resizeSinceNs, command.sinceNs, [&] { return resize(command.width, command.height); });
+                    break;
+                }
+            }
+        });
+        frameLoop = renderLoop.get();
+
+        target->release();
+        renderThread = std::thread([this] {
+            renderFrames(*renderLoop, {this});
+            target->release();
+            renderDone.store(true, std::memory_order_release);
+            // 指定フレーム数に達した場合などは、メインスレッドのループも終了させる
+            client.loop().quit();
+        });
+    }
+
+    // 描画スレッドに指示を送り、eventfdで描画スレッドのepoll_waitを起こす（メインスレッドから呼ぶ）
+    // キューが満杯の場合は、描画スレッドが取り出すまで待つ（起こす通知はpush済みの指示に対して送ってある）
+    // 描画スレッドが終了している場合は捨てる
+    void post(const RenderCommand &command)
+    {
+        while (!renderCommands.push(command))
+        {
+            if (renderDone.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        const uint64_t one = 1;
+        ssize_t written = write(renderWakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    // 描画スレッドで、受信時刻sinceNsの変化をapplyで反映する
+    // applyが再描画を要求した（trueを返した）場合は、pendingNsに記録してそのフレームのコミットまでの時間を計測する
+    // 待機中はapplyの中ですぐに描画・コミットされるため、先に記録しておき、要求しなかった場合は取り消す
+    template <typename Apply>
+    static void applyTimed(uint64_t &pendingNs, uint64_t sinceNs, Apply apply)
+    {
+        const uint64_t previousNs = pendingNs;
+        if (previousNs == 0)
+        {
+            pendingNs = sinceNs;
+        }
+        if (!apply() && previousNs == 0)
+        {
+            pendingNs = 0;
+        }
+    }
+
+    // 描画スレッドを止め、以降のイベント（サイズの変更等）をメインスレッドで処理する
+    // 描画先は描画スレッドの終了時に解放されているため、メインスレッドで再び使える
+    void stopRenderThread()
+    {
+        post({RenderCommand::Kind::Stop});
+        renderThread.join();
+
+        // 描画スレッドのループに登録したタイマーは、そのループが使われなくなる前に外す
+        leaveIdle();
+        toplevel->setDeferResizeAck(false);
+        frameLoop = &client.loop();
+    }
+
+    // 途中経過の出力に使う、最新のフレームの状態
+    // 描画スレッドがある場合はFrameStatsに直接触れず、描画スレッドが書き込んだ値を読む
+    // 2つの値は別々に更新されるため、読む間にフレームが進むと隣のフレームの値の組になりうる（表示用なので許容する）
+    FrameReport latestFrameReport() const
+    {
+        if (!options.renderThread)
+        {
+            return {stats.frames(), stats.lastFrameMs()};
+        }
+        const uint64_t frames = reportedFrames.load(std::memory_order_acquire);
+        return {frames, reportedFrameMs.load(std::memory_order_relaxed)};
+    }
+
+    // イベントループにWaylandの接続・終了シグナル・途中経過の出力タイマーを登録する
+    // 途中経過はこのウィンドウのもの
+    void initEventLoop(const char *label)
+    {
+        EventLoop &eventLoop = client.loop();
+        eventLoop.setDisplay(client.display());
+        eventLoop.addSignals({SIGINT, SIGTERM}, [&eventLoop](int) { eventLoop.quit(); });
+        if (options.reportIntervalSec > 0.0)
+        {
+            const auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(options.reportIntervalSec));
+            eventLoop.addTimer(interval, interval, [this, label](uint64_t) {
+                const FrameReport report = latestFrameReport();
+                std::cout << "[" << label << "] progress"
+                          << " t=" << std::chrono::duration<double>(FrameStats::Clock::now() - startTime).count() << "s"
+                          << " frames=" << report.frames
+                          << " last_frame_ms=" << report.frameMs
+                          << " rss_kb=" << process_memory::residentKb() << std::endl;
+            });
+        }
+        if (options.mainBusyMs > 0)
+        {
+            // 重いイベント処理の代わりに、メインスレッドを一定時間占有する
+            eventLoop.addTimer(std::chrono::milliseconds(100), std::chrono::milliseconds(100), [this](uint64_t) {
+                const auto until = FrameStats::Clock::now() + std::chrono::milliseconds(options.mainBusyMs);
+                while (FrameStats::Clock::now() < until)
+                {
+                }
+            });
+        }
+    }
+
+    // コンポジタが次のフレームの描画を要求したタイミングで呼ばれる
+    // 画面に表示されない（隠れている）間は呼ばれないため、無駄な描画を行わずに済む
+    static void frameDone(void *data, wl_callback *callback, uint32_t time)
+    {
+        auto *self = static_cast<WaylandWindow *>(data);
+        wl_callback_destroy(callback);
+        self->frameCallback = nullptr;
+
+        // 最初のフレームに対するコールバック＝最初のフレームがコンポジタに表示された
+        if (self->frameCount == 1 && self->index == 0)
+        {
+            startupTrace().mark("first_frame_presented");
+            startupTrace().finish();
+        }
+
+        // アニメーション中は毎回、停止中は入力によって再描画が要求されている場合だけ描画する
+        // 要求がなければ次のフレームコールバックは要求せず、入力があるまで待機する
+        if (self->frameLoop->isRunning() && !self->finished && (!self->paused || self->redrawRequested))
+        {
+            self->redraw();
+        }
+        else
+        {
+            self->enterIdle();
+        }
+    }
+
+    // 描画を止めて入力を待ち始めた（--low-memory）
+    // ・すぐに：描画先のidle()（wl_shmでは表示中のバッファ以外を破棄してシングルバッファにする）
+    // ・idleTrimSec秒後：描画先のtrim()（wl_shmでは空いた領域の物理メモリを返却する）
+    // 再び描画する時は、描画先が必要なバッファを確保し直す
+    void enterIdle()
+    {
+        if (!options.lowMemory || idleTimer >= 0)
+        {
+            return;
+        }
+        target->idle();
+
+        const auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(options.idleTrimSec));
+        idleTimer = frameLoop->addTimer(delay, std::chrono::nanoseconds(0), [this](uint64_t) {
+            frameLoop->removeSource(idleTimer);
+            idleTimer = -1;
+            target->trim();
+        });
+    }
+
+    void leaveIdle()
+    {
+        if (idleTimer >= 0)
+        {
+            frameLoop->removeSource(idleTimer);
+            idleTimer = -1;
+        }
+    }
+
+    // 入力の通知を各ウィンドウに振り分ける
+    // ・ポインタ：ポインタが入っているサーフェスのウィンドウに再描画を要求する（ひし形がポインタに追従する）
+    // ・Esc：終了、スペース：アニメーションの停止と再開（全ウィンドウ）
+    // 入力のイベントは常にメインスレッド（既定のキュー）で処理する。描画スレッドがある場合は、指示として描画スレッドに渡す
+    static void initInput(WaylandClient &client, const std::vector<WaylandWindow *> &windows)
+    {
+        SeatInput &input = client.wayland().input;
+        input.onChange = [windows, &input] {
+            for (WaylandWindow *window : windows)
+            {
+                window->pointerChanged(input);
+            }
+        };
+        input.onKey = [windows, &client, &input](uint32_t key) {
+            bool redrawScheduled = false;
+            if (key == KEY_ESC)
+            {
+                // 描画スレッドがある場合も、メインスレッドのループを抜ければstopRenderThreadで止まる
+                client.loop().quit();
+            }
+            else if (key == KEY_SPACE)
+            {
+                for (WaylandWindow *window : windows)
+                {
+                    redrawScheduled |= window->pauseKeyPressed(input);
+                }
+            }
+            return redrawScheduled;
+        };
+    }
+
+    // ポインタの状態が変わった（メインスレッド）
+    // 描画スレッドがある場合は、状態と受信時刻を描画スレッドに渡す
+    void pointerChanged(SeatInput &input)
+    {
+        if (options.renderThread)
+        {
+            RenderCommand command{RenderCommand::Kind::Pointer};
+            command.pointer = input.pointer();
+            command.sinceNs = input.takeUnreflected();
+            post(command);
+            return;
+        }
+        applyPointer(input.pointer());
+    }
+
+    // ポインタの状態をこのウィンドウの描画に反映する
+    // このウィンドウの上での変化であれば再描画を要求し、trueを返す
+    bool applyPointer(const SeatInput::PointerState &state)
+    {
+        pointerState = state;
+        double offsetX;
+        return surfaceOffset(state.surface, offsetX) && scheduleRedraw();
+    }
+
+    // surfaceがこのウィンドウのサーフェス（または描画先のサブサーフェス）の場合はtrueを返し、
+    // offsetXにウィンドウのサーフェスの座標への変換量を書き込む
+    bool surfaceOffset(wl_surface *surface, double &offsetX) const
+    {
+        if (surface == wlSurface)
+        {
+            offsetX = 0.0;
+            return true;
+        }
+        return surface && target->subsurfaceOffset(surface, offsetX);
+    }
+
+    // スペースキーが押された（メインスレッド）
+    // 描画スレッドがある場合は、停止の状態を持つ描画スレッドに受信時刻と一緒に渡し、
+    // 再描画するかどうかの判断と計測は描画スレッドが行う（受信時刻は渡したのでtrueを返す）
+    bool pauseKeyPressed(SeatInput &input)
+    {
+        if (options.renderThread)
+        {
+            RenderCommand command{RenderCommand::Kind::Pause};
+            command.sinceNs = input.takeUnreflected();
+            post(command);
+            return true;
+        }
+        return togglePause();
+    }
+
+    // 入力によって再描画が必要になった
+    // フレームコールバックを待っている間は要求を記録するだけで、届いた時に1回だけ描画する
+    // （ポインタを素早く動かして何度呼ばれても、描画はフレームコールバック1回につき1回）
+    // 待っていない場合（アニメーションを止めて待機している間）は、すぐに描画する
+    // 再描画を要求した（またはすぐに描画した）場合はtrue
+    bool scheduleRedraw()
+    {
+        // --uncappedでは描画ループが常に描き続けているため、次のフレームで反映される
+        if (finished)
+        {
+            return false;
+        }
+        if (options.uncapped)
+        {
+            return true;
+        }
+        if (frameCallback)
+        {
+            redrawRequested = true;
+            return true;
+        }
+        redraw();
+        return true;
+    }
+
+    // 再開して再描画を要求した場合はtrue（停止はすでに要求済みのフレームに反映されるだけ）
+    bool togglePause()
+    {
+        const auto now = FrameStats::Clock::now();
+        if (paused)
+        {
+            pausedTotal += now - pausedAt;
+            paused = false;
+            return scheduleRedraw();
+        }
+        pausedAt = now;
+        paused = true;
+        return false;
+    }
+
+    // アニメーションの経過時間（停止している間は進まない）
+    float animationSec() const
+    {
+        const auto now = paused ? pausedAt : FrameStats::Clock::now();
+        return std::chrono::duration<float>(now - startTime - pausedTotal).count();
+    }
+
+    // 今回のフレームのひし形の中心のx座標
+    // ポインタがこのウィンドウ（または描画先のサブサーフェス）の上にある間はポインタに追従させ、それ以外はアニメーションさせる
+    float frameCenterX() const
+    {
+        double offsetX;
+        if (pointerState.inside && surfaceOffset(pointerState.surface, offsetX))
+        {
+            // サーフェス座標を正規化デバイス座標にし、ひし形が画面からはみ出さない範囲に収める
+            const float x = static_cast<float>((pointerState.x + offsetX) / width * 2.0 - 1.0);
+            return std::max(-1.0f + scene::diamondRadius, std::min(1.0f - scene::diamondRadius, x));
+        }
+        return scene::diamondCenterX(animationSec());
+    }
+
+    // 1フレーム分の描画と提示を行う
+    void redraw()
+    {
+        const auto frameStart = FrameStats::Clock::now();
+        leaveIdle();
+
+        if (!options.uncapped)
+        {
+            // 次のフレームコールバックを要求する（EGLではeglSwapBuffers内部で行われるコミットに含まれて送信される）
+            // 描画を見送った場合でも、次の機会に再度描画できるよう先に要求しておく
+            frameCallback = wl_surface_frame(frameSurface);
+            wl_callback_add_listener(frameCallback, &frameListener, this);
+        }
+
+        const RenderTarget::Frame frame{frameCount + 1, frameCenterX(), renderSizeChanged};
+        const auto workStart = FrameStats::Clock::now();
+        bool drawn;
+        if (frameCount == 0 && index == 0)
+        {
+            auto phase = startupTrace().phase("first_frame_draw");
+            drawn = target->draw(frame);
+        }
+        else
+        {
+            drawn = target->draw(frame);
+        }
+        if (!drawn)
+        {
+            // コンポジタがまだ読み取っていない（releaseされていない）バッファしかない
+            // フレームコールバックの要求だけをコミットし、次のフレームで描き直す
+            wl_surface_commit(wlSurface);
+            frameCostMs += std::chrono::duration<double, std::milli>(FrameStats::Clock::now() - frameStart).count();
+            return;
+        }
+        redrawRequested = false;
+
+        // コミットの直前にフィードバックを要求する
+        // 応答待ちの枠を全ウィンドウで奪い合わないよう、最初のウィンドウについてのみ要求する
+        if (index == 0)
+        {
+            client.wayland().presentation.attach(frameSurface);
+        }
+        // 入力やサイズの変更を受け取ってから、それを反映したこのコミットまでの時間を記録する
+        SeatInput &input = client.wayland().input;
+        double offsetX;
+        if (options.renderThread)
+        {
+            // 描画スレッドが反映した入力の受信時刻（入力のイベント自体はメインスレッドが処理している）
+            input.committed(inputSinceNs);
+            inputSinceNs = 0;
+            toplevel->committed(resizeSinceNs);
+            resizeSinceNs = 0;
+        }
+        else
+        {
+            if (!pointerState.surface || surfaceOffset(pointerState.surface, offsetX))
+            {
+                input.committed();
+            }
+            // 新しいサイズの内容がまだない（--layersで背景を描き直せなかった）場合は、次のコミットまで待つ
+            if (target->sizeCommitted())
+            {
+                toplevel->committed();
+            }
+        }
+        if (frameCount == 0 && index == 0)
+        {
+            auto phase = startupTrace().phase("first_frame_swap");
+            target->present();
+        }
+        else
+        {
+            target->present();
+        }
+        renderSizeChanged = false;
+        // 描画時間（描画の開始からコミットまで）で描画解像度を調整する。変更は次のフレームから反映される
+        if (resolution.addFrame(std::chrono::duration<double, std::milli>(FrameStats::Clock::now() - workStart).count()))
+        {
+            resizeRenderTarget();
+        }
+        stats.frame();
+        protocolStats().frame();
+        ++frameCount;
+        frameCostMs += std::chrono::duration<double, std::milli>(FrameStats::Clock::now() - frameStart).count();
+        if (options.renderThread)
+        {
+            reportedFrameMs.store(stats.lastFrameMs(), std::memory_order_relaxed);
+            reportedFrames.store(stats.frames(), std::memory_order_release);
+        }
+
+        // フレームコールバックを使わないモードでは、最初のコミットが戻った時点を提示とみなす
+        if (frameCount == 1 && options.uncapped && index == 0)
+        {
+            startupTrace().mark("first_frame_presented");
+            startupTrace().finish();
+        }
+
+        if (options.maxFrames != 0 && stats.frames() >= options.maxFrames)
+        {
+            finish();
+        }
+    }
+
+    // このウィンドウの描画を終える
+    // 描画スレッドではそのループを、それ以外では全ウィンドウが描き終えた時点で共有のループを終了する
+    void finish()
+    {
+        if (finished)
+        {
+            return;
+        }
+        finished = true;
+        if (options.renderThread)
+        {
+            frameLoop->quit();
+        }
+        else
+        {
+            client.windowFinished();
+        }
+    }
+
+    // コンポジタがウィンドウのサイズを変えた（xdg_toplevel.configure）
+    // 描画先のバッファは作り直さずにサイズだけを変える（EGLではwl_egl_window_resize、wl_shmでは確保済みの領域を使い回す）
+    // 新しいサイズのフレームは、次のフレームコールバックで（待機中はすぐに）描画する。再描画を要求した場合はtrue
+    bool resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        setOpaqueRegion();
+        if (viewport)
+        {
+            wp_viewport_set_destination(viewport, width, height);
+        }
+        resizeRenderTarget();
+        // 最初のフレームはrun()で描画する（他のウィンドウの作成中にconfigureが届いた場合）
+        return frameCount > 0 && scheduleRedraw();
+    }
+
+    // コンポジタがウィンドウのサイズを変えた（メインスレッド）
+    // 描画スレッドがある場合（ackを止めている場合）は、新しいサイズとシリアル・受信時刻を描画スレッドに渡す
+    void configured(int newWidth, int newHeight)
+    {
+        if (toplevel->resizeAckDeferred())
+        {
+            RenderCommand command{RenderCommand::Kind::Resize};
+            command.width = newWidth;
+            command.height = newHeight;
+            command.serial = toplevel->serial();
+            command.sinceNs = toplevel->takeResized();
+            post(command);
+            return;
+        }
+        resize(newWidth, newHeight);
+    }
+
+    // サーフェス全体が不透明であることをコンポジタに伝える
+    // コンポジタはこの範囲のアルファブレンドや、背後にあるサーフェスの描画を省略できる（次のコミットで反映される）
+    void setOpaqueRegion()
+    {
+        if (options.translucent)
+        {
+            return;
+        }
+        wl_region *opaque = wl_compositor_create_region(client.wayland().compositor);
+        wl_region_add(opaque, 0, 0, width, height);
+        wl_surface_set_opaque_region(wlSurface, opaque);
+        wl_region_destroy(opaque);
+    }
+
+    // 描画サイズを表示サイズとresolutionの倍率に合わせる
+    // サーフェスの表示サイズはwp_viewportの拡大先（width x height）のまま変わらない
+    void resizeRenderTarget()
+    {
+        renderWidth = resolution.scaled(width);
+        renderHeight = resolution.scaled(height);
+        target->resize(width, height, renderWidth, renderHeight);
+        renderSizeChanged = true;
+    }
+
+    // このウィンドウのwl_surfaceを作成し、トップレベルのウィンドウとして表示させる
+    void initSurface()
+    {
+        if (index == 0)
+        {
+            std::cout << "Surface生成" << std::endl;
+        }
+        WaylandConnection::Globals &globals = client.wayland();
+        // ウィンドウやウィジェットなど、画面に表示するための基本的な描画領域
+        wlSurface = wl_compositor_create_surface(globals.compositor);
+        assert(wlSurface);
+        frameSurface = wlSurface;
+
+        // サーフェスにトップレベルのウィンドウとしての役割を与える（xdg_surface + xdg_toplevel）
+        // 主にアプリケーションのメインインターフェースとして使われ、メニューバー、ツールバー、ステータスバー、コンテンツ表示エリアなどを含むこともある
+        // またデスクトップ上で独立して存在し、通常、タイトルバー、最小化、最大化、閉じるボタンなどのウィンドウ管理機能が付随される。
+        // （今回はなにも付随していない）
+        // 最初のconfigureを待つ間も、バックエンドの準備（EGLの初期化）はワーカースレッドで進む
+        // コンポジタがサイズを指定した場合は、そのサイズで描画先を作る
+        const std::string title = std::string("my-wayland-client (") + client.renderer().name() + ")";
+        toplevel.reset(new XdgToplevel(globals.shell.get(), wlSurface, title.c_str(), width, height));
+        {
+            auto phase = startupTrace().phase("xdg_configure");
+            toplevel->waitForConfigure(client.display());
+        }
+        width = renderWidth = toplevel->width();
+        height = renderHeight = toplevel->height();
+        toplevel->onResize = [this](int newWidth, int newHeight) { configured(newWidth, newHeight); };
+        toplevel->onClose = [this] {
+            // 描画スレッドがある場合は、メインスレッドのループを抜ければstopRenderThreadで止まる
+            if (options.renderThread)
+            {
+                client.loop().quit();
+            }
+            else
+            {
+                finish();
+            }
+        };
+
+        setOpaqueRegion();
+    }
+
+    // 動的解像度：バッファのサイズに関わらず、サーフェスをwidth x heightで表示させる
+    void initViewport()
+    {
+        if (!resolution.enabled())
+        {
+            return;
+        }
+        if (client.wayland().viewporter && target->scalable())
+        {
+            viewport = wp_viewporter_get_viewport(client.wayland().viewporter, wlSurface);
+            wp_viewport_set_destination(viewport, width, height);
+            return;
+        }
+        if (index == 0)
+        {
+            std::cout << "[" << client.renderer().name()
+                      << "] --frame-budget is ignored: it needs wp_viewporter and cannot be combined with --layers" << std::endl;
+        }
+        resolution = ResolutionController();
+    }
+};
+
+inline const wl_callback_listener WaylandWindow::frameListener = {WaylandWindow::frameDone};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <time.h>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include "presentation_feedback.h"
+#include "xdg-shell-client-protocol.h"
+
+// xdg_wm_base（xdg-shell）：サーフェスにウィンドウとしての役割を与えるグローバル
+// 非推奨のwl_shellに代わるもので、コンポジタからのpingに応答しないと「応答なし」として扱われる
+class XdgShell
+{
+public:
+    XdgShell() = default;
+    ~XdgShell() { destroy(); }
+
+    XdgShell(const XdgShell &) = delete;
+    XdgShell &operator=(const XdgShell &) = delete;
+
+    // レジストリでxdg_wm_baseが見つかったときに呼ぶ
+    void bind(wl_registry *registry, uint32_t id)
+    {
+        wmBase = static_cast<xdg_wm_base *>(wl_registry_bind(registry, id, &xdg_wm_base_interface, 1));
+        xdg_wm_base_add_listener(wmBase, &wmBaseListener, this);
+    }
+
+    // プロキシを破棄する。wl_display_disconnectより前に、全てのXdgToplevelを破棄してから呼ぶ
+    void destroy()
+    {
+        if (wmBase)
+        {
+            xdg_wm_base_destroy(wmBase);
+            wmBase = nullptr;
+        }
+    }
+
+    bool supported() const { return wmBase != nullptr; }
+    xdg_wm_base *get() const { return wmBase; }
+
+private:
+    static void ping(void *, xdg_wm_base *wmBase, uint32_t serial)
+    {
+        xdg_wm_base_pong(wmBase, serial);
+    }
+
+    static const xdg_wm_base_listener wmBaseListener;
+
+    xdg_wm_base *wmBase = nullptr;
+};
+
+inline const xdg_wm_base_listener XdgShell::wmBaseListener = {XdgShell::ping};
+
+// サーフェスをトップレベルのウィンドウ（xdg_surface + xdg_toplevel）にし、コンポジタからのconfigureに従ってサイズを変える
+//
+// configureの流れ
+// ・xdg_toplevel.configureで新しいサイズ（0はクライアントに任せる）が届き、xdg_surface.configureで確定する
+// ・確定したらack_configureを送り、サイズが変わった場合はonResizeを呼ぶ。ウィンドウは次のコミットで新しいサイズのバッファを出す
+// ・最初のバッファは最初のconfigureを受け取ってからでないとアタッチできない（waitForConfigure）
+//
+// サイズの変更を受け取ってから、新しいサイズのフレームをコミットするまでの時間（resize-to-commit）を計測する
+//
+// サイズの変更を別のスレッド（描画スレッド）で反映する場合は、configureはイベントを処理するスレッドで受け取ったまま、
+// setDeferResizeAck(true)でサイズが変わった時のack_configureを止める
+// onResizeの中でserial()とtakeResized()を取り出して反映するスレッドに渡し、そのスレッドが新しいサイズのフレームの直前に
+// ackConfigure(シリアル)、コミットの直前にcommitted(受信時刻)を呼ぶ（ackの後のコミットがconfigureへの応答になるため、
+// 先にackすると古いサイズのフレームが応答とみなされる）
+class XdgToplevel
+{
+public:
+    // width x heightは、コンポジタがサイズを指定しない（0を送ってくる）場合のサイズ
+    XdgToplevel(xdg_wm_base *wmBase, wl_surface *surface, const char *title, int width, int height)
+        : currentWidth(width), currentHeight(height)
+    {
+        xdgSurface = xdg_wm_base_get_xdg_surface(wmBase, surface);
+        xdg_surface_add_listener(xdgSurface, &surfaceListener, this);
+        toplevel = xdg_surface_get_toplevel(xdgSurface);
+        xdg_toplevel_add_listener(toplevel, &toplevelListener, this);
+        xdg_toplevel_set_title(toplevel, title);
+        xdg_toplevel_set_app_id(toplevel, "my-wayland-client");
+        // バッファなしでコミットし、最初のconfigureを要求する
+        wl_surface_commit(surface);
+    }
+
+    // wl_surfaceより先に破棄する
+    ~XdgToplevel()
+    {
+        xdg_toplevel_destroy(toplevel);
+        xdg_surface_destroy(xdgSurface);
+    }
+
+    XdgToplevel(const XdgToplevel &) = delete;
+    XdgToplevel &operator=(const XdgToplevel &) = delete;
+
+    // コンポジタがサイズを変えた（ack_configureの直後に呼ばれる）
+    std::function<void(int width, int height)> onResize;
+    // ユーザーがウィンドウを閉じようとした
+    std::function<void()> onClose;
+
+    // 最初のconfigureが届くまで、displayの既定のキューをディスパッチする
+    void waitForConfigure(wl_display *display)
+    {
+        while (!configured)
+        {
+            if (wl_display_dispatch(display) < 0)
+            {
+                throw std::runtime_error("Connection lost while waiting for xdg_surface.configure");
+            }
+        }
+    }
+
+    // 新しいサイズのフレームをコミットする直前に呼ぶ
+    void committed()
+    {
+        committed(takeResized());
+    }
+
+    // 以下はサイズの変更を別のスレッドで反映する場合（クラスの先頭の説明を参照）
+    void setDeferResizeAck(bool defer) { deferResizeAck = defer; }
+    bool resizeAckDeferred() const { return deferResizeAck; }
+    // 最後に受け取ったconfigureのシリアル
+    uint32_t serial() const { return lastSerial; }
+    void ackConfigure(uint32_t serial) { xdg_surface_ack_configure(xdgSurface, serial); }
+    // まだコミットしていない最初のサイズの変更の受信時刻を取り出す（0は変更なし）
+    uint64_t takeResized()
+    {
+        const uint64_t receivedNs = resizedSinceNs;
+        resizedSinceNs = 0;
+        return receivedNs;
+    }
+    // receivedNsは0の場合は何もしない
+    void committed(uint64_t receivedNs)
+    {
+        if (receivedNs != 0)
+        {
+            latency.add((now() - receivedNs) / 1e6);
+        }
+    }
+
+    bool isConfigured() const { return configured; }
+    int width() const { return currentWidth; }
+    int height() const { return currentHeight; }
+    uint64_t resizeCount() const { return resizes; }
+
+    void report(std::ostream &os, const char *label) const
+    {
+        os << "[" << label << "] configures=" << configures
+           << " resizes=" << resizes;
+        latency.report(os, "resize_to_commit");
+        os << std::endl;
+    }
+
+private:
+    static uint64_t now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    static void toplevelConfigure(void *data, xdg_toplevel *, int32_t width, int32_t height, wl_array *)
+    {
+        auto *self = static_cast<XdgToplevel *>(data);
+        self->pendingWidth = width;
+        self->pendingHeight = height;
+    }
+
+    static void toplevelClose(void *data, xdg_toplevel *)
+    {
+        auto *self = static_cast<XdgToplevel *>(data);
+        if (self->onClose)
+        {
+            self->onClose();
+        }
+    }
+
+    static void surfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+    {
+        auto *self = static_cast<XdgToplevel *>(data);
+        self->configured = true;
+        ++self->configures;
+        self->lastSerial = serial;
+
+        // 0はクライアントに任せるという意味なので、今のサイズを保つ
+        const int width = self->pendingWidth > 0 ? self->pendingWidth : self->currentWidth;
+        const int height = self->pendingHeight > 0 ? self->pendingHeight : self->currentHeight;
+        if (width == self->currentWidth && height == self->currentHeight)
+        {
+            xdg_surface_ack_configure(xdgSurface, serial);
+            return;
+        }
+        if (!self->deferResizeAck)
+        {
+            xdg_surface_ack_configure(xdgSurface, serial);
+        }
+        self->currentWidth = width;
+        self->currentHeight = height;
+        ++self->resizes;
+        // 前の変更がまだコミットされていない場合は、その時刻から計る
+        if (self->resizedSinceNs == 0)
+        {
+            self->resizedSinceNs = now();
+        }
+        if (self->onResize)
+        {
+            self->onResize(width, height);
+        }
+    }
+
+    static const xdg_surface_listener surfaceListener;
+    static const xdg_toplevel_listener toplevelListener;
+
+    xdg_surface *xdgSurface = nullptr;
+    xdg_toplevel *toplevel = nullptr;
+    bool configured = false;
+    int currentWidth, currentHeight;
+    int pendingWidth = 0, pendingHeight = 0;
+    uint32_t lastSerial = 0;
+    bool deferResizeAck = false;
+
+    uint64_t configures = 0;
+    uint64_t resizes = 0;
+    uint64_t resizedSinceNs = 0;
+    LatencyHistogram latency;
+};
+
+inline const xdg_surface_listener XdgToplevel::surfaceListener = {XdgToplevel::surfaceConfigure};
+inline const xdg_toplevel_listener XdgToplevel::toplevelListener = {XdgToplevel::toplevelConfigure, XdgToplevel::toplevelClose};